@@ -0,0 +1,321 @@
+#include "BenchHarness.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "Qgfx/Common/FixedBlockMemoryAllocator.hpp"
+#include "Qgfx/Common/LinearAllocator.hpp"
+#include "Qgfx/Common/MemoryAllocator.hpp"
+#include "Qgfx/Common/PoolAllocator.hpp"
+
+#if QGFX_PLATFORM_LINUX
+#include "Qgfx/Platform/Linux/LinuxVirtualMemoryAllocator.hpp"
+#endif
+
+namespace Qgfx
+{
+    namespace Bench
+    {
+        // Size of the blocks in the fixed-size benchmarks, a typical small object
+        static constexpr size_t BlockSize = 64;
+
+        // Number of blocks allocated before they are freed again
+        static constexpr uint32_t BatchSize = 256;
+
+        static constexpr uint32_t NumRounds = 2000;
+
+        static constexpr uint32_t NumFramesInFlight = 3;
+
+        static constexpr size_t CommandBufferSize = 512;
+
+        struct AllocatorConfig
+        {
+            const char* Name;
+
+            std::unique_ptr<IMemoryAllocator> (*Create)();
+
+            /// Whether the allocator serves requests of any size, or only BlockSize
+            bool bAnySize;
+        };
+
+        static const std::vector<AllocatorConfig>& GetAllocatorConfigs()
+        {
+            static const std::vector<AllocatorConfig> s_Configs = {
+                { "Raw", []() -> std::unique_ptr<IMemoryAllocator> { return std::make_unique<DefaultRawMemoryAllocator>(); }, true },
+                { "FixedBlock", []() -> std::unique_ptr<IMemoryAllocator> { return std::make_unique<FixedBlockMemoryAllocator>(DefaultRawMemoryAllocator::GetAllocator(), BlockSize, 256); }, false },
+                { "FixedBlockNoCache", []() -> std::unique_ptr<IMemoryAllocator> { return std::make_unique<FixedBlockMemoryAllocator>(DefaultRawMemoryAllocator::GetAllocator(), BlockSize, 256, 0); }, false },
+                { "Pool", []() -> std::unique_ptr<IMemoryAllocator> { return std::make_unique<PoolAllocator>(); }, true },
+#if QGFX_PLATFORM_LINUX
+                { "FixedBlockOnVirtualMemory", []() -> std::unique_ptr<IMemoryAllocator> { return std::make_unique<FixedBlockMemoryAllocator>(LinuxVirtualMemoryAllocator::GetAllocator(), BlockSize, 256); }, false },
+                { "PoolOnVirtualMemory", []() -> std::unique_ptr<IMemoryAllocator> { return std::make_unique<PoolAllocator>(LinuxVirtualMemoryAllocator::GetAllocator()); }, true },
+#endif
+            };
+            return s_Configs;
+        }
+
+        // Request sizes for the mixed-size benchmarks. Small sizes dominate, as they do for engine objects.
+        static const std::vector<uint32_t>& GetMixedSizes()
+        {
+            static const std::vector<uint32_t> s_Sizes = []() {
+                std::vector<uint32_t> Sizes(BatchSize);
+                Random                Rng{ 1 };
+                for (uint32_t& Size : Sizes)
+                {
+                    const uint32_t Bucket = Rng.Next(0, 9);
+                    Size = Bucket < 6 ? Rng.Next(8, 128) : (Bucket < 9 ? Rng.Next(129, 1024) : Rng.Next(1025, 8192));
+                }
+                return Sizes;
+            }();
+            return s_Sizes;
+        }
+
+        static void Touch(void* Ptr, size_t Size)
+        {
+            // Write the first and last byte, so that the memory is really committed
+            static_cast<volatile uint8_t*>(Ptr)[0] = 1;
+            static_cast<volatile uint8_t*>(Ptr)[Size - 1] = 1;
+        }
+
+        // Allocates BatchSize blocks and frees them in allocation order, which leaves free lists in a
+        // different order than a LIFO pattern would and is closer to how objects actually die.
+        static uint64_t AllocFreeLoop(IMemoryAllocator& Allocator, const uint32_t* pSizes, uint32_t NumRounds)
+        {
+            void* Blocks[BatchSize];
+            for (uint32_t Round = 0; Round < NumRounds; ++Round)
+            {
+                for (uint32_t i = 0; i < BatchSize; ++i)
+                {
+                    const size_t Size = pSizes != nullptr ? pSizes[i] : BlockSize;
+                    Blocks[i] = Allocator.Allocate(Size);
+                    Touch(Blocks[i], Size);
+                }
+
+                for (uint32_t i = 0; i < BatchSize; ++i)
+                    Allocator.Free(Blocks[i]);
+            }
+            return uint64_t{ NumRounds } * BatchSize;
+        }
+
+        static uint64_t ProducerConsumer(IMemoryAllocator& Allocator, uint32_t NumPairs, uint32_t NumRounds)
+        {
+            // Hand blocks over in batches, so that the queue lock is not what is being measured
+            struct Queue
+            {
+                std::mutex                     Mutex;
+                std::condition_variable        CondVar;
+                std::deque<std::vector<void*>> Batches;
+            };
+
+            static constexpr size_t MaxQueuedBatches = 16;
+
+            std::vector<std::unique_ptr<Queue>> Queues(NumPairs);
+            for (auto& pQueue : Queues)
+                pQueue = std::make_unique<Queue>();
+
+            return RunOnThreads(NumPairs * 2, [&](uint32_t ThreadIndex) -> uint64_t {
+                Queue& Queue = *Queues[ThreadIndex / 2];
+                if (ThreadIndex % 2 == 0)
+                {
+                    for (uint32_t Round = 0; Round < NumRounds; ++Round)
+                    {
+                        std::vector<void*> Batch(BatchSize);
+                        for (void*& Ptr : Batch)
+                        {
+                            Ptr = Allocator.Allocate(BlockSize);
+                            Touch(Ptr, BlockSize);
+                        }
+
+                        std::unique_lock<std::mutex> Lock{ Queue.Mutex };
+                        Queue.CondVar.wait(Lock, [&]() { return Queue.Batches.size() < MaxQueuedBatches; });
+                        Queue.Batches.push_back(std::move(Batch));
+                        Queue.CondVar.notify_all();
+                    }
+                    return 0;
+                }
+                else
+                {
+                    for (uint32_t Round = 0; Round < NumRounds; ++Round)
+                    {
+                        std::vector<void*> Batch;
+                        {
+                            std::unique_lock<std::mutex> Lock{ Queue.Mutex };
+                            Queue.CondVar.wait(Lock, [&]() { return !Queue.Batches.empty(); });
+                            Batch = std::move(Queue.Batches.front());
+                            Queue.Batches.pop_front();
+                            Queue.CondVar.notify_all();
+                        }
+
+                        for (void* Ptr : Batch)
+                            Allocator.Free(Ptr);
+                    }
+                    return uint64_t{ NumRounds } * BatchSize;
+                }
+            });
+        }
+
+        enum class ChurnStrategy
+        {
+            // Every object comes from the raw allocator
+            eRaw,
+            // Command buffers come from a FixedBlockMemoryAllocator and recorded objects from a PoolAllocator
+            ePooled,
+            // Command buffers are created and destroyed in batches, and recorded objects come from a
+            // per-thread LinearAllocator that is reset when the frame completes
+            eBatched
+        };
+
+        // Mimics command buffer recording: every frame creates a varying number of command buffers, each
+        // with a handful of small recorded objects, and everything is destroyed NumFramesInFlight frames
+        // later when the frame is known to be complete. Returns the number of objects created.
+        static uint64_t CommandBufferChurn(ChurnStrategy Strategy, uint32_t NumThreads, uint32_t NumFrames)
+        {
+            DefaultRawMemoryAllocator& RawAllocator = DefaultRawMemoryAllocator::GetAllocator();
+            FixedBlockMemoryAllocator  CommandBufferAllocator{ RawAllocator, CommandBufferSize, 64 };
+            PoolAllocator              ObjectAllocator{ RawAllocator };
+
+            return RunOnThreads(NumThreads, [&](uint32_t ThreadIndex) -> uint64_t {
+                struct FrameData
+                {
+                    std::vector<void*> CommandBuffers;
+                    std::vector<void*> Objects;
+                };
+
+                FrameData       Frames[NumFramesInFlight];
+                LinearAllocator ScratchAllocator{ RawAllocator };
+                Random          Rng{ ThreadIndex + 1 };
+                uint64_t        NumObjects = 0;
+
+                auto RetireFrame = [&](FrameData& Frame, uint64_t FrameIndex) {
+                    switch (Strategy)
+                    {
+                    case ChurnStrategy::eRaw:
+                        for (void* Ptr : Frame.CommandBuffers)
+                            RawAllocator.Free(Ptr);
+                        for (void* Ptr : Frame.Objects)
+                            RawAllocator.Free(Ptr);
+                        break;
+
+                    case ChurnStrategy::ePooled:
+                        for (void* Ptr : Frame.CommandBuffers)
+                            CommandBufferAllocator.Free(Ptr);
+                        for (void* Ptr : Frame.Objects)
+                            ObjectAllocator.Free(Ptr);
+                        break;
+
+                    case ChurnStrategy::eBatched:
+                        CommandBufferAllocator.FreeBatch(static_cast<uint32_t>(Frame.CommandBuffers.size()), Frame.CommandBuffers.data());
+                        ScratchAllocator.ReleaseCompleted(FrameIndex);
+                        break;
+                    }
+                    Frame.CommandBuffers.clear();
+                    Frame.Objects.clear();
+                };
+
+                for (uint64_t FrameIndex = 0; FrameIndex < NumFrames; ++FrameIndex)
+                {
+                    FrameData& Frame = Frames[FrameIndex % NumFramesInFlight];
+                    if (FrameIndex >= NumFramesInFlight)
+                        RetireFrame(Frame, FrameIndex - NumFramesInFlight);
+
+                    ScratchAllocator.SetCurrentIndex(FrameIndex);
+
+                    const uint32_t NumCommandBuffers = Rng.Next(16, 64);
+                    Frame.CommandBuffers.resize(NumCommandBuffers);
+                    if (Strategy == ChurnStrategy::eBatched)
+                    {
+                        CommandBufferAllocator.AllocateBatch(NumCommandBuffers, Frame.CommandBuffers.data());
+                    }
+                    else
+                    {
+                        for (void*& Ptr : Frame.CommandBuffers)
+                            Ptr = Strategy == ChurnStrategy::eRaw ? RawAllocator.Allocate(CommandBufferSize) : CommandBufferAllocator.Allocate(CommandBufferSize);
+                    }
+
+                    for (void* pCommandBuffer : Frame.CommandBuffers)
+                    {
+                        Touch(pCommandBuffer, CommandBufferSize);
+
+                        const uint32_t NumRecordedObjects = Rng.Next(4, 16);
+                        for (uint32_t i = 0; i < NumRecordedObjects; ++i)
+                        {
+                            const size_t Size = Rng.Next(16, 256);
+                            void*        Ptr = nullptr;
+                            switch (Strategy)
+                            {
+                            case ChurnStrategy::eRaw: Ptr = RawAllocator.Allocate(Size); break;
+                            case ChurnStrategy::ePooled: Ptr = ObjectAllocator.Allocate(Size); break;
+                            case ChurnStrategy::eBatched: Ptr = ScratchAllocator.Allocate(Size); break;
+                            }
+                            Touch(Ptr, Size);
+
+                            if (Strategy != ChurnStrategy::eBatched)
+                                Frame.Objects.push_back(Ptr);
+                        }
+                        NumObjects += 1 + NumRecordedObjects;
+                    }
+                }
+
+                for (uint64_t FrameIndex = NumFrames > NumFramesInFlight ? NumFrames - NumFramesInFlight : 0; FrameIndex < NumFrames; ++FrameIndex)
+                    RetireFrame(Frames[FrameIndex % NumFramesInFlight], FrameIndex);
+
+                return NumObjects;
+            });
+        }
+
+        void RegisterAllocatorBenchmarks()
+        {
+            for (const AllocatorConfig& Config : GetAllocatorConfigs())
+            {
+                const AllocatorConfig* pConfig = &Config;
+
+                RegisterBenchmark(std::string{ "AllocFree/" } + Config.Name, 1, [pConfig](const BenchmarkContext& Context) {
+                    std::unique_ptr<IMemoryAllocator> pAllocator = pConfig->Create();
+                    return AllocFreeLoop(*pAllocator, nullptr, NumRounds * Context.Scale);
+                });
+
+                if (Config.bAnySize)
+                {
+                    RegisterBenchmark(std::string{ "AllocFreeMixedSizes/" } + Config.Name, 1, [pConfig](const BenchmarkContext& Context) {
+                        std::unique_ptr<IMemoryAllocator> pAllocator = pConfig->Create();
+                        return AllocFreeLoop(*pAllocator, GetMixedSizes().data(), NumRounds * Context.Scale);
+                    });
+                }
+
+                RegisterBenchmark(std::string{ "AllocFreeThreaded/" } + Config.Name, 0, [pConfig](const BenchmarkContext& Context) {
+                    std::unique_ptr<IMemoryAllocator> pAllocator = pConfig->Create();
+                    return RunOnThreads(Context.NumThreads, [&](uint32_t) {
+                        return AllocFreeLoop(*pAllocator, nullptr, NumRounds * Context.Scale);
+                    });
+                });
+
+                // Pairs of threads, so only even thread counts are meaningful
+                RegisterBenchmark(std::string{ "ProducerConsumer/" } + Config.Name, 0, [pConfig](const BenchmarkContext& Context) {
+                    std::unique_ptr<IMemoryAllocator> pAllocator = pConfig->Create();
+                    return ProducerConsumer(*pAllocator, std::max(Context.NumThreads / 2, uint32_t{ 1 }), NumRounds * Context.Scale);
+                });
+            }
+
+            static const std::pair<const char*, ChurnStrategy> ChurnStrategies[] = {
+                { "Raw", ChurnStrategy::eRaw },
+                { "Pooled", ChurnStrategy::ePooled },
+                { "Batched", ChurnStrategy::eBatched },
+            };
+            for (const auto& Strategy : ChurnStrategies)
+            {
+                const ChurnStrategy Type = Strategy.second;
+
+                RegisterBenchmark(std::string{ "CommandBufferChurn/" } + Strategy.first, 1, [Type](const BenchmarkContext& Context) {
+                    return CommandBufferChurn(Type, 1, NumRounds * Context.Scale);
+                });
+
+                RegisterBenchmark(std::string{ "CommandBufferChurnThreaded/" } + Strategy.first, 0, [Type](const BenchmarkContext& Context) {
+                    return CommandBufferChurn(Type, Context.NumThreads, NumRounds * Context.Scale);
+                });
+            }
+        }
+    }
+}
@@ -0,0 +1,236 @@
+#include "BenchHarness.hpp"
+
+#include <string>
+#include <thread>
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+#include "Qgfx/Common/HybridLock.hpp"
+#include "Qgfx/Common/IRefCountedObject.hpp"
+#include "Qgfx/Common/SpinLock.hpp"
+#include "Qgfx/Platform/Atomics.hpp"
+
+namespace Qgfx
+{
+    namespace Bench
+    {
+        static constexpr uint32_t NumIterations = 1 << 22;
+
+        // Baselines that use the sequentially consistent Atomics functions, which is what the refcount
+        // and the spin lock did before they were given explicit memory orders
+
+        struct SeqCstRefCount
+        {
+            AtomicLong RefCount{ 1 };
+
+            void AddRef() { Atomics::Increment(RefCount); }
+            void Release()
+            {
+                if (Atomics::Decrement(RefCount) == 0)
+                    QGFX_UNEXPECTED("The benchmark always holds one reference");
+            }
+        };
+
+        // Same protocol with the orders IRefCountedObject uses
+        struct OrderedRefCount
+        {
+            AtomicLong RefCount{ 1 };
+
+            void AddRef() { Atomics::Increment(RefCount, MemoryOrder::eRelaxed); }
+            void Release()
+            {
+                if (Atomics::Decrement(RefCount, MemoryOrder::eRelease) == 0)
+                {
+                    Atomics::ThreadFence(MemoryOrder::eAcquire);
+                    QGFX_UNEXPECTED("The benchmark always holds one reference");
+                }
+            }
+        };
+
+        struct SeqCstSpinLock
+        {
+            AtomicLong Flag{ 0 };
+
+            void Lock()
+            {
+                int SpinCount = 0;
+                while (Atomics::CompareExchange(Flag, Long{ 1 }, Long{ 0 }) != 0)
+                {
+                    if (++SpinCount == SpinLock::DefaultSpinCountToYield)
+                    {
+                        SpinCount = 0;
+                        std::this_thread::yield();
+                    }
+                }
+            }
+
+            void Unlock() { Atomics::Store(Flag, Long{ 0 }); }
+        };
+
+        // The spin lock before it became test and test-and-set: a compare-exchange on every spin and no pause
+        struct CasSpinLock
+        {
+            AtomicLong Flag{ 0 };
+
+            void Lock()
+            {
+                int SpinCount = 0;
+                while (Atomics::CompareExchange(Flag, Long{ 1 }, Long{ 0 }, MemoryOrder::eAcquire) != 0)
+                {
+                    if (++SpinCount == SpinLock::DefaultSpinCountToYield)
+                    {
+                        SpinCount = 0;
+                        std::this_thread::yield();
+                    }
+                }
+            }
+
+            void Unlock() { Atomics::Store(Flag, Long{ 0 }, MemoryOrder::eRelease); }
+        };
+
+        class BenchRefCountedObject final : public IRefCountedObject
+        {
+        public:
+            BenchRefCountedObject() = default;
+        };
+
+        class BenchSingleThreadedObject final : public RefCountedObject<SingleThreaded>
+        {
+        public:
+            BenchSingleThreadedObject() = default;
+        };
+
+        // Keeps the compiler from moving memory accesses across it, without emitting any instruction
+        static inline void CompilerBarrier()
+        {
+#if defined(_MSC_VER)
+            _ReadWriteBarrier();
+#else
+            asm volatile("" ::: "memory");
+#endif
+        }
+
+        template <typename RefCountedType>
+        static uint64_t AddRefReleaseLoop(RefCountedType& Object, uint32_t NumIterations)
+        {
+            for (uint32_t i = 0; i < NumIterations; ++i)
+            {
+                Object.AddRef();
+                // Plain counts would otherwise let the compiler fold the pair away, so the count is
+                // stored and loaded again, as it is when the references are taken in different places
+                CompilerBarrier();
+                Object.Release();
+            }
+            return NumIterations;
+        }
+
+        template <typename LockFunctionType>
+        static uint64_t LockUnlockLoop(LockFunctionType&& LockUnlock, uint32_t NumIterations)
+        {
+            // Something for the critical section to protect
+            static volatile uint64_t s_Counter = 0;
+            for (uint32_t i = 0; i < NumIterations; ++i)
+                LockUnlock([]() { s_Counter = s_Counter + 1; });
+            return NumIterations;
+        }
+
+        void RegisterAtomicsBenchmarks()
+        {
+            RegisterBenchmark("RefCount/SeqCst", 1, [](const BenchmarkContext& Context) {
+                SeqCstRefCount RefCount;
+                return AddRefReleaseLoop(RefCount, NumIterations * Context.Scale);
+            });
+
+            RegisterBenchmark("RefCount/Ordered", 1, [](const BenchmarkContext& Context) {
+                OrderedRefCount RefCount;
+                return AddRefReleaseLoop(RefCount, NumIterations * Context.Scale);
+            });
+
+            RegisterBenchmark("RefCount/IRefCountedObject", 1, [](const BenchmarkContext& Context) {
+                // The object holds one reference on creation, so AddRef()/Release() pairs never destroy it
+                BenchRefCountedObject* pObject = new BenchRefCountedObject;
+                const uint64_t         NumOps = AddRefReleaseLoop(*pObject, NumIterations * Context.Scale);
+                pObject->Release();
+                return NumOps;
+            });
+
+            RegisterBenchmark("RefCount/SingleThreaded", 1, [](const BenchmarkContext& Context) {
+                // A plain increment and decrement, against the atomic ones of RefCount/IRefCountedObject
+                BenchSingleThreadedObject* pObject = new BenchSingleThreadedObject;
+                const uint64_t             NumOps = AddRefReleaseLoop(*pObject, NumIterations * Context.Scale);
+                pObject->Release();
+                return NumOps;
+            });
+
+            RegisterBenchmark("RefCountShared/SeqCst", 0, [](const BenchmarkContext& Context) {
+                SeqCstRefCount RefCount;
+                return RunOnThreads(Context.NumThreads, [&](uint32_t) { return AddRefReleaseLoop(RefCount, NumIterations / 4 * Context.Scale); });
+            });
+
+            RegisterBenchmark("RefCountShared/Ordered", 0, [](const BenchmarkContext& Context) {
+                OrderedRefCount RefCount;
+                return RunOnThreads(Context.NumThreads, [&](uint32_t) { return AddRefReleaseLoop(RefCount, NumIterations / 4 * Context.Scale); });
+            });
+
+            RegisterBenchmark("RefCountShared/IRefCountedObject", 0, [](const BenchmarkContext& Context) {
+                BenchRefCountedObject* pObject = new BenchRefCountedObject;
+                const uint64_t         NumOps = RunOnThreads(Context.NumThreads, [&](uint32_t) { return AddRefReleaseLoop(*pObject, NumIterations / 4 * Context.Scale); });
+                pObject->Release();
+                return NumOps;
+            });
+
+            RegisterBenchmark("SpinLock/SeqCst", 1, [](const BenchmarkContext& Context) {
+                SeqCstSpinLock Lock;
+                return LockUnlockLoop([&](auto&& CriticalSection) { Lock.Lock(); CriticalSection(); Lock.Unlock(); }, NumIterations * Context.Scale);
+            });
+
+            RegisterBenchmark("SpinLock/Ordered", 1, [](const BenchmarkContext& Context) {
+                SpinLockFlag LockFlag;
+                return LockUnlockLoop([&](auto&& CriticalSection) { SpinLock Lock{ LockFlag }; CriticalSection(); }, NumIterations * Context.Scale);
+            });
+
+            RegisterBenchmark("SpinLockContended/SeqCst", 0, [](const BenchmarkContext& Context) {
+                SeqCstSpinLock Lock;
+                return RunOnThreads(Context.NumThreads, [&](uint32_t) {
+                    return LockUnlockLoop([&](auto&& CriticalSection) { Lock.Lock(); CriticalSection(); Lock.Unlock(); }, NumIterations / 16 * Context.Scale);
+                });
+            });
+
+            RegisterBenchmark("SpinLockContended/Ordered", 0, [](const BenchmarkContext& Context) {
+                SpinLockFlag LockFlag;
+                return RunOnThreads(Context.NumThreads, [&](uint32_t) {
+                    return LockUnlockLoop([&](auto&& CriticalSection) { SpinLock Lock{ LockFlag }; CriticalSection(); }, NumIterations / 16 * Context.Scale);
+                });
+            });
+
+            // Contended locking at fixed thread counts, independent of --threads
+            for (uint32_t NumThreads = 2; NumThreads <= 32; NumThreads *= 2)
+            {
+                const uint32_t NumIterationsPerThread = NumIterations / 2 / NumThreads;
+
+                RegisterBenchmark("SpinLockScaling/CAS/" + std::to_string(NumThreads), NumThreads, [=](const BenchmarkContext& Context) {
+                    CasSpinLock Lock;
+                    return RunOnThreads(NumThreads, [&](uint32_t) {
+                        return LockUnlockLoop([&](auto&& CriticalSection) { Lock.Lock(); CriticalSection(); Lock.Unlock(); }, NumIterationsPerThread * Context.Scale);
+                    });
+                });
+
+                RegisterBenchmark("SpinLockScaling/TTAS/" + std::to_string(NumThreads), NumThreads, [=](const BenchmarkContext& Context) {
+                    SpinLockFlag LockFlag;
+                    return RunOnThreads(NumThreads, [&](uint32_t) {
+                        return LockUnlockLoop([&](auto&& CriticalSection) { SpinLock Lock{ LockFlag }; CriticalSection(); }, NumIterationsPerThread * Context.Scale);
+                    });
+                });
+
+                RegisterBenchmark("SpinLockScaling/Hybrid/" + std::to_string(NumThreads), NumThreads, [=](const BenchmarkContext& Context) {
+                    HybridLockFlag LockFlag;
+                    return RunOnThreads(NumThreads, [&](uint32_t) {
+                        return LockUnlockLoop([&](auto&& CriticalSection) { HybridLock Lock{ LockFlag }; CriticalSection(); }, NumIterationsPerThread * Context.Scale);
+                    });
+                });
+            }
+        }
+    }
+}
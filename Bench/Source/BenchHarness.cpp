@@ -0,0 +1,97 @@
+#include "BenchHarness.hpp"
+
+#include <atomic>
+#include <thread>
+
+#if QGFX_PLATFORM_WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace Qgfx
+{
+    namespace Bench
+    {
+        std::vector<Benchmark>& GetBenchmarks()
+        {
+            static std::vector<Benchmark> s_Benchmarks;
+            return s_Benchmarks;
+        }
+
+        void RegisterBenchmark(std::string Name, uint32_t NumThreads, BenchmarkFunction Function)
+        {
+            GetBenchmarks().push_back(Benchmark{ std::move(Name), std::move(Function), NumThreads });
+        }
+
+#if QGFX_PLATFORM_WIN32
+        size_t GetPeakResidentSetSize()
+        {
+            PROCESS_MEMORY_COUNTERS Counters{};
+            GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters));
+            return Counters.PeakWorkingSetSize;
+        }
+
+        size_t GetCurrentResidentSetSize()
+        {
+            PROCESS_MEMORY_COUNTERS Counters{};
+            GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters));
+            return Counters.WorkingSetSize;
+        }
+#else
+        size_t GetPeakResidentSetSize()
+        {
+            rusage Usage{};
+            getrusage(RUSAGE_SELF, &Usage);
+            // Linux reports kilobytes
+            return static_cast<size_t>(Usage.ru_maxrss) * 1024;
+        }
+
+        size_t GetCurrentResidentSetSize()
+        {
+            FILE* pFile = fopen("/proc/self/statm", "r");
+            if (pFile == nullptr)
+                return 0;
+
+            unsigned long NumPages = 0, NumResidentPages = 0;
+            const int     NumFields = fscanf(pFile, "%lu %lu", &NumPages, &NumResidentPages);
+            fclose(pFile);
+            return NumFields == 2 ? static_cast<size_t>(NumResidentPages) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+        }
+#endif
+
+        uint64_t RunOnThreads(uint32_t NumThreads, const std::function<uint64_t(uint32_t ThreadIndex)>& Function)
+        {
+            std::atomic<uint32_t> NumReadyThreads{ 0 };
+            std::atomic<bool>     bStart{ false };
+            std::atomic<uint64_t> NumOps{ 0 };
+
+            std::vector<std::thread> Threads;
+            Threads.reserve(NumThreads);
+            for (uint32_t i = 0; i < NumThreads; ++i)
+            {
+                Threads.emplace_back([&, i]() {
+                    NumReadyThreads.fetch_add(1);
+                    while (!bStart.load(std::memory_order_acquire))
+                        std::this_thread::yield();
+
+                    NumOps.fetch_add(Function(i));
+                });
+            }
+
+            // Release the threads together, so that they really contend instead of the first
+            // ones finishing before the last ones have started
+            while (NumReadyThreads.load() != NumThreads)
+                std::this_thread::yield();
+            bStart.store(true, std::memory_order_release);
+
+            for (std::thread& Thread : Threads)
+                Thread.join();
+
+            return NumOps.load();
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Qgfx
+{
+    namespace Bench
+    {
+        struct BenchmarkContext
+        {
+            /// Number of threads the benchmark should use where it is multi-threaded
+            uint32_t NumThreads = 4;
+
+            /// Scales the amount of work done by each benchmark
+            uint32_t Scale = 1;
+        };
+
+        /// Runs the benchmark once and returns the number of operations it performed. What an operation is
+        /// (an allocation/free pair, an object created in a frame, ...) is up to the benchmark, but it must be
+        /// the same for all allocators the benchmark is registered for, so that their results compare.
+        using BenchmarkFunction = std::function<uint64_t(const BenchmarkContext& Context)>;
+
+        struct Benchmark
+        {
+            std::string       Name;
+            BenchmarkFunction Function;
+
+            /// Number of threads doing the operations, used to turn wall time into time per operation per thread.
+            /// Zero means BenchmarkContext::NumThreads.
+            uint32_t NumThreads = 1;
+        };
+
+        /// Returns the list that benchmarks register themselves in
+        std::vector<Benchmark>& GetBenchmarks();
+
+        void RegisterBenchmark(std::string Name, uint32_t NumThreads, BenchmarkFunction Function);
+
+        /// Registers the allocator benchmarks, see AllocatorBenchmarks.cpp
+        void RegisterAllocatorBenchmarks();
+
+        /// Registers the refcount and lock benchmarks, see AtomicsBenchmarks.cpp
+        void RegisterAtomicsBenchmarks();
+
+        /// Registers the deferred deletion benchmarks and the DeferredDeletionQueue check, see DeferredDeletionBenchmarks.cpp
+        void RegisterDeferredDeletionBenchmarks();
+
+        /// Registers the hash map benchmarks and the FlatHashMap check, see HashMapBenchmarks.cpp
+        void RegisterHashMapBenchmarks();
+
+        /// Returns the highest resident set size of the process so far, in bytes
+        size_t GetPeakResidentSetSize();
+
+        /// Returns the current resident set size of the process, in bytes
+        size_t GetCurrentResidentSetSize();
+
+        /// Runs Function on NumThreads threads, which are released at the same time, and waits for them to finish.
+        /// Returns the sum of the operation counts returned by the threads.
+        uint64_t RunOnThreads(uint32_t NumThreads, const std::function<uint64_t(uint32_t ThreadIndex)>& Function);
+
+        /// Small deterministic random number generator, so that every run and every allocator sees the same sequence
+        class Random
+        {
+        public:
+            explicit Random(uint64_t Seed) :
+                m_State{ Seed * 6364136223846793005ull + 1442695040888963407ull }
+            {
+            }
+
+            uint32_t Next()
+            {
+                m_State = m_State * 6364136223846793005ull + 1442695040888963407ull;
+                return static_cast<uint32_t>(m_State >> 33);
+            }
+
+            /// Returns a number in [Min, Max]
+            uint32_t Next(uint32_t Min, uint32_t Max) { return Min + Next() % (Max - Min + 1); }
+
+        private:
+            uint64_t m_State;
+        };
+    }
+}
@@ -0,0 +1,163 @@
+#include "BenchHarness.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "Qgfx/Common/DeferredDeletionQueue.hpp"
+#include "Qgfx/Common/IRefCountedObject.hpp"
+#include "Qgfx/Common/MemoryAllocator.hpp"
+
+namespace Qgfx
+{
+    namespace Bench
+    {
+        static constexpr uint32_t NumObjects = 1 << 16;
+
+        // Type and id of every destroyed object, in the order the destructors ran
+        static std::vector<std::pair<uint32_t, uint32_t>> s_DestroyLog;
+
+        /// Object of one of several types that logs its destruction, and may own another object it releases
+        /// from its destructor
+        template <uint32_t TypeId>
+        class LoggedObject final : public DeferredDeletionObject<LoggedObject<TypeId>>
+        {
+        public:
+            LoggedObject(DeferredDeletionQueue* pDeletionQueue, uint32_t Id, IRefCountedObject* pChild = nullptr) :
+                DeferredDeletionObject<LoggedObject<TypeId>>{ pDeletionQueue },
+                m_Id{ Id },
+                m_pChild{ pChild }
+            {
+            }
+
+            ~LoggedObject()
+            {
+                s_DestroyLog.emplace_back(TypeId, m_Id);
+                if (m_pChild != nullptr)
+                    m_pChild->Release();
+            }
+
+        private:
+            const uint32_t           m_Id;
+            IRefCountedObject* const m_pChild;
+        };
+
+        static void CheckFailed(const char* Message)
+        {
+            fprintf(stderr, "DeferredDeletionQueue check failed: %s\n", Message);
+            abort();
+        }
+
+        /// Checks that the entries of the log in [Begin, End) are grouped by type, and in id order within a type
+        static bool IsGroupedInOrder(size_t Begin, size_t End)
+        {
+            std::vector<bool> bTypeSeen(3, false);
+            for (size_t i = Begin; i < End; ++i)
+            {
+                const uint32_t Type = s_DestroyLog[i].first;
+                const bool     bSameRun = i > Begin && s_DestroyLog[i - 1].first == Type;
+                if (bSameRun ? s_DestroyLog[i - 1].second >= s_DestroyLog[i].second : bTypeSeen[Type])
+                    return false;
+                bTypeSeen[Type] = true;
+            }
+            return true;
+        }
+
+        /// Retires objects of interleaved types, some of which release another object from their destructor,
+        /// and checks the order Drain() destroys them in. Then checks weak pointers to a retired object.
+        static uint64_t VerifyLoop(uint32_t NumOps)
+        {
+            DeferredDeletionQueue Queue{ DefaultRawMemoryAllocator::GetAllocator() };
+            s_DestroyLog.clear();
+            s_DestroyLog.reserve(NumOps * 2);
+
+            // Every type 0 object owns a type 2 object, which is only retired when its owner is destroyed
+            uint32_t NumChildren = 0;
+            for (uint32_t i = 0; i < NumOps; ++i)
+            {
+                IRefCountedObject* pObject = nullptr;
+                if (i % 2 == 0)
+                    pObject = new LoggedObject<0>{ &Queue, i, new LoggedObject<2>{ &Queue, NumChildren++ } };
+                else
+                    pObject = new LoggedObject<1>{ &Queue, i };
+                pObject->Release();
+            }
+
+            if (!s_DestroyLog.empty() || !Queue.HasRetiredObjects())
+                CheckFailed("objects were destroyed before Drain()");
+
+            if (Queue.Drain() != NumOps + NumChildren || s_DestroyLog.size() != NumOps + NumChildren || Queue.HasRetiredObjects())
+                CheckFailed("Drain() did not destroy every object, including the ones retired by destructors");
+
+            // The children are retired while the objects that own them are destroyed, so they come last
+            if (!IsGroupedInOrder(0, NumOps) || !IsGroupedInOrder(NumOps, s_DestroyLog.size()) || s_DestroyLog[NumOps].first != 2)
+                CheckFailed("objects were not destroyed grouped by type and in retire order within a type");
+
+            // A retired object can no longer be locked, but is only destroyed by Drain()
+            s_DestroyLog.clear();
+            LoggedObject<1>*         pObject = new LoggedObject<1>{ &Queue, 0 };
+            WeakPtr<LoggedObject<1>> pWeak{ pObject };
+            if (!pWeak.IsValid() || !pWeak.Lock())
+                CheckFailed("a weak pointer to a live object could not be locked");
+
+            pObject->Release();
+            if (pWeak.IsValid() || pWeak.Lock() || !s_DestroyLog.empty())
+                CheckFailed("a weak pointer to a retired object could be locked, or the object was destroyed before Drain()");
+
+            if (Queue.Drain() != 1 || s_DestroyLog.size() != 1 || pWeak.IsValid() || pWeak.Lock())
+                CheckFailed("an object with a weak pointer to it was not destroyed by Drain()");
+
+            // Without a queue the object is deleted when the last reference is released
+            s_DestroyLog.clear();
+            (new LoggedObject<0>{ nullptr, 0 })->Release();
+            if (s_DestroyLog.size() != 1 || Queue.HasRetiredObjects())
+                CheckFailed("an object without a queue was not deleted immediately");
+
+            return NumOps;
+        }
+
+        /// Releases objects of interleaved types, deleting each one right away or retiring it to Queue and
+        /// draining once at the end, which is the end of a frame in an engine
+        static uint64_t ReleaseLoop(DeferredDeletionQueue* pQueue, uint32_t NumOps)
+        {
+            std::vector<IRefCountedObject*> Objects;
+            Objects.reserve(NumOps);
+            for (uint32_t i = 0; i < NumOps; ++i)
+            {
+                switch (i % 3)
+                {
+                    case 0: Objects.push_back(new LoggedObject<0>{ pQueue, i }); break;
+                    case 1: Objects.push_back(new LoggedObject<1>{ pQueue, i }); break;
+                    default: Objects.push_back(new LoggedObject<2>{ pQueue, i }); break;
+                }
+            }
+
+            s_DestroyLog.clear();
+            for (IRefCountedObject* pObject : Objects)
+                pObject->Release();
+            if (pQueue != nullptr)
+                pQueue->Drain();
+
+            return NumOps;
+        }
+
+        void RegisterDeferredDeletionBenchmarks()
+        {
+            RegisterBenchmark("DeferredDeletion/Verify", 1, [](const BenchmarkContext& Context) {
+                return VerifyLoop(NumObjects / 4 * Context.Scale);
+            });
+
+            RegisterBenchmark("DeferredDeletion/Immediate", 1, [](const BenchmarkContext& Context) {
+                s_DestroyLog.reserve(NumObjects * Context.Scale);
+                return ReleaseLoop(nullptr, NumObjects * Context.Scale);
+            });
+
+            RegisterBenchmark("DeferredDeletion/Drain", 1, [](const BenchmarkContext& Context) {
+                DeferredDeletionQueue Queue{ DefaultRawMemoryAllocator::GetAllocator() };
+                s_DestroyLog.reserve(NumObjects * Context.Scale);
+                return ReleaseLoop(&Queue, NumObjects * Context.Scale);
+            });
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#include "BenchHarness.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+
+#include "Qgfx/Common/FlatHashMap.hpp"
+#include "Qgfx/Common/MemoryAllocator.hpp"
+
+namespace Qgfx
+{
+    namespace Bench
+    {
+        static constexpr uint32_t NumKeys = 1 << 16;
+        static constexpr uint32_t NumOperations = 1 << 22;
+
+        // Both maps are driven through the same small interface, so that every benchmark runs the same code on them
+
+        struct FlatMap
+        {
+            FlatHashMap<uint64_t, uint64_t> Map{ DefaultRawMemoryAllocator::GetAllocator() };
+
+            void      Insert(uint64_t Key, uint64_t Value) { Map.Emplace(Key, Value); }
+            bool      Erase(uint64_t Key) { return Map.Erase(Key); }
+            uint64_t* Find(uint64_t Key) { return Map.Find(Key); }
+            size_t    GetSize() const { return Map.GetSize(); }
+        };
+
+        struct StdMap
+        {
+            std::unordered_map<uint64_t, uint64_t> Map;
+
+            void      Insert(uint64_t Key, uint64_t Value) { Map.emplace(Key, Value); }
+            bool      Erase(uint64_t Key) { return Map.erase(Key) != 0; }
+            uint64_t* Find(uint64_t Key)
+            {
+                auto It = Map.find(Key);
+                return It != Map.end() ? &It->second : nullptr;
+            }
+            size_t GetSize() const { return Map.size(); }
+        };
+
+        // Spread the keys like the hashes of descriptions, rather than making them consecutive
+        static uint64_t GetKey(uint32_t Index)
+        {
+            return (static_cast<uint64_t>(Index) << 32) | (Index * 2654435761u);
+        }
+
+        /// Finds keys in a map of NumKeys keys, half of the lookups miss
+        template <typename MapType>
+        static uint64_t LookupLoop(uint32_t NumLookups)
+        {
+            MapType Map;
+            for (uint32_t i = 0; i < NumKeys; ++i)
+                Map.Insert(GetKey(i), i);
+
+            Random   Rng{ 1 };
+            uint64_t NumHits = 0;
+            for (uint32_t i = 0; i < NumLookups; ++i)
+            {
+                if (Map.Find(GetKey(Rng.Next(0, NumKeys * 2 - 1))) != nullptr)
+                    ++NumHits;
+            }
+
+            // Keep the lookups from being optimized away
+            static volatile uint64_t s_NumHits = 0;
+            s_NumHits = s_NumHits + NumHits;
+            return NumLookups;
+        }
+
+        /// Inserts, erases and finds random keys, which keeps the map around half full and leaves deleted slots behind
+        template <typename MapType>
+        static uint64_t ChurnLoop(uint32_t NumOps)
+        {
+            MapType Map;
+            Random  Rng{ 2 };
+            for (uint32_t i = 0; i < NumOps; ++i)
+            {
+                const uint64_t Key = GetKey(Rng.Next(0, NumKeys - 1));
+                switch (Rng.Next(0, 2))
+                {
+                    case 0: Map.Insert(Key, i); break;
+                    case 1: Map.Erase(Key); break;
+                    default: Map.Find(Key); break;
+                }
+            }
+            return NumOps;
+        }
+
+        /// Runs the churn operations on both maps and stops the process if they ever disagree
+        static uint64_t VerifyLoop(uint32_t NumOps)
+        {
+            FlatMap Map;
+            StdMap  Reference;
+            Random  Rng{ 3 };
+            for (uint32_t i = 0; i < NumOps; ++i)
+            {
+                const uint64_t Key = GetKey(Rng.Next(0, NumKeys / 16 - 1));
+
+                bool bMatches = true;
+                switch (Rng.Next(0, 2))
+                {
+                    case 0:
+                        Map.Insert(Key, Key);
+                        Reference.Insert(Key, Key);
+                        break;
+
+                    case 1:
+                        bMatches = Map.Erase(Key) == Reference.Erase(Key);
+                        break;
+
+                    default:
+                    {
+                        const uint64_t* pValue = Map.Find(Key);
+                        bMatches = (pValue != nullptr) == (Reference.Find(Key) != nullptr) && (pValue == nullptr || *pValue == Key);
+                        break;
+                    }
+                }
+
+                if (!bMatches || Map.GetSize() != Reference.GetSize())
+                {
+                    fprintf(stderr, "FlatHashMap disagrees with std::unordered_map after %u operations\n", i + 1);
+                    abort();
+                }
+            }
+
+            // Erase everything through EraseIf() and check that ForEach() sees nothing left
+            size_t NumErased = Map.Map.EraseIf([](const uint64_t&, uint64_t&) { return true; });
+            size_t NumLeft = 0;
+            Map.Map.ForEach([&](const uint64_t&, uint64_t&) { ++NumLeft; });
+            if (NumErased != Reference.GetSize() || NumLeft != 0 || !Map.Map.IsEmpty())
+            {
+                fprintf(stderr, "FlatHashMap::EraseIf() left %zu elements, erased %zu of %zu\n", NumLeft, NumErased, Reference.GetSize());
+                abort();
+            }
+
+            return NumOps;
+        }
+
+        void RegisterHashMapBenchmarks()
+        {
+            RegisterBenchmark("HashMap/Verify", 1, [](const BenchmarkContext& Context) {
+                return VerifyLoop(NumOperations / 4 * Context.Scale);
+            });
+
+            RegisterBenchmark("HashMap/Lookup/FlatHashMap", 1, [](const BenchmarkContext& Context) {
+                return LookupLoop<FlatMap>(NumOperations * Context.Scale);
+            });
+
+            RegisterBenchmark("HashMap/Lookup/unordered_map", 1, [](const BenchmarkContext& Context) {
+                return LookupLoop<StdMap>(NumOperations * Context.Scale);
+            });
+
+            RegisterBenchmark("HashMap/Churn/FlatHashMap", 1, [](const BenchmarkContext& Context) {
+                return ChurnLoop<FlatMap>(NumOperations * Context.Scale);
+            });
+
+            RegisterBenchmark("HashMap/Churn/unordered_map", 1, [](const BenchmarkContext& Context) {
+                return ChurnLoop<StdMap>(NumOperations * Context.Scale);
+            });
+        }
+    }
+}
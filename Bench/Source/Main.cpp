@@ -0,0 +1,97 @@
+#include "BenchHarness.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Qgfx::Bench;
+
+static void PrintUsage(const char* ProgramName)
+{
+    printf("Usage: %s [options]\n"
+           "  --filter <text>  Run only benchmarks whose name contains <text>\n"
+           "  --threads <n>    Number of threads for threaded benchmarks (default 4)\n"
+           "  --repeat <n>     Number of runs of every benchmark, the median is reported (default 5)\n"
+           "  --scale <n>      Multiplies the amount of work done by every benchmark (default 1)\n"
+           "  --list           Print the benchmark names and exit\n"
+           "\n"
+           "ns/op is wall time per operation and thread, so it stays flat when a benchmark scales perfectly.\n"
+           "Peak RSS is the high-water mark of the whole process. Run one benchmark per process with --filter\n"
+           "to compare the peak memory of allocators.\n",
+           ProgramName);
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkContext Context;
+    const char*      Filter = nullptr;
+    uint32_t         NumRepeats = 5;
+    bool             bList = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool bHasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--filter") == 0 && bHasValue)
+            Filter = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && bHasValue)
+            Context.NumThreads = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--repeat") == 0 && bHasValue)
+            NumRepeats = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--scale") == 0 && bHasValue)
+            Context.Scale = std::max(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--list") == 0)
+            bList = true;
+        else
+        {
+            PrintUsage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    RegisterAllocatorBenchmarks();
+    RegisterAtomicsBenchmarks();
+    RegisterDeferredDeletionBenchmarks();
+    RegisterHashMapBenchmarks();
+
+    if (!bList)
+        printf("%-44s %8s %12s %14s %14s\n", "Benchmark", "Threads", "ns/op", "Peak RSS, MiB", "RSS, MiB");
+
+    for (const Benchmark& Bench : GetBenchmarks())
+    {
+        if (Filter != nullptr && Bench.Name.find(Filter) == std::string::npos)
+            continue;
+
+        if (bList)
+        {
+            printf("%s\n", Bench.Name.c_str());
+            continue;
+        }
+
+        const uint32_t NumThreads = Bench.NumThreads != 0 ? Bench.NumThreads : Context.NumThreads;
+
+        std::vector<double> NsPerOp;
+        for (uint32_t Repeat = 0; Repeat < NumRepeats; ++Repeat)
+        {
+            const auto     StartTime = std::chrono::steady_clock::now();
+            const uint64_t NumOps = Bench.Function(Context);
+            const auto     EndTime = std::chrono::steady_clock::now();
+
+            const double Ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(EndTime - StartTime).count());
+            NsPerOp.push_back(NumOps != 0 ? Ns * NumThreads / static_cast<double>(NumOps) : 0.0);
+        }
+
+        std::sort(NsPerOp.begin(), NsPerOp.end());
+
+        printf("%-44s %8u %12.2f %14.1f %14.1f\n",
+               Bench.Name.c_str(),
+               NumThreads,
+               NsPerOp[NsPerOp.size() / 2],
+               static_cast<double>(GetPeakResidentSetSize()) / (1 << 20),
+               static_cast<double>(GetCurrentResidentSetSize()) / (1 << 20));
+        fflush(stdout);
+    }
+
+    return 0;
+}
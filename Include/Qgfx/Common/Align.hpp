@@ -1,12 +1,16 @@
 #pragma once
 
 
+#include <cstddef>
 #include <cstdint>
+#include <type_traits>
 
 #include "Error.hpp"
 
 namespace Qgfx
 {
+    /// Assumed size of a cache line, used to keep independently written data on separate lines.
+    static constexpr size_t CacheLineSize = 64;
 
     template <typename T>
     bool IsPowerOfTwo(T val)
@@ -14,6 +18,17 @@ namespace Qgfx
         return val > 0 && (val & (val - 1)) == 0;
     }
 
+    /// Returns the smallest power of two that is greater than or equal to val
+    template <typename T>
+    T AlignUpToPowerOfTwo(T val)
+    {
+        static_assert(std::is_unsigned<T>::value, "type must be unsigned");
+        T res = 1;
+        while (res < val)
+            res <<= 1;
+        return res;
+    }
+
     template <typename T1, typename T2>
     inline typename std::conditional<sizeof(T1) >= sizeof(T2), T1, T2>::type AlignUp(T1 val, T2 alignment)
     {
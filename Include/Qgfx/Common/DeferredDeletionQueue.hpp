@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "Error.hpp"
+#include "MemoryAllocator.hpp"
+#include "IRefCountedObject.hpp"
+
+namespace Qgfx
+{
+    /// Collects objects whose ref count has dropped to zero, and destroys them in bulk when Drain() is called.
+
+    /// Objects opt in by deriving from DeferredDeletionObject. When such an object is released for the
+    /// last time it is pushed to a lock-free list instead of being deleted on the releasing thread, so a
+    /// render thread never pays for a destructor in the middle of a frame. Drain() is then called at a
+    /// chosen point, such as the end of a frame or on a background thread, and runs the destructors
+    /// grouped by type.
+    ///
+    /// Retire() may be called from any thread. Drain() must only be called from one thread at a time.
+    class DeferredDeletionQueue
+    {
+    public:
+        /// Link embedded in every object that can be retired to the queue
+        struct Node
+        {
+            explicit Node(void (*pfnDestroy)(Node*)) noexcept :
+                pfnDestroy{ pfnDestroy }
+            {
+            }
+
+            Node* pNext = nullptr;
+
+            // Deletes the object. Objects of the same type share the function, so it doubles as the type the
+            // destructors are grouped by.
+            void (*const pfnDestroy)(Node*);
+        };
+
+        /// \param [in] RawMemoryAllocator - allocator used for the list Drain() sorts the retired objects in.
+        explicit DeferredDeletionQueue(IMemoryAllocator& RawMemoryAllocator);
+
+        /// Destroys all objects that are still retired
+        ~DeferredDeletionQueue();
+
+        /// Adds an object whose ref count has dropped to zero. The object is destroyed by the next Drain().
+        void Retire(Node* pNode) noexcept
+        {
+            Node* pHead = m_pHead.load(std::memory_order_relaxed);
+            do
+            {
+                pNode->pNext = pHead;
+            } while (!m_pHead.compare_exchange_weak(pHead, pNode, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        /// Destroys all retired objects, including the ones retired by the destructors it runs.
+        /// \return The number of objects destroyed.
+        size_t Drain();
+
+        /// Returns true if there are objects waiting for Drain(). The result may be out of date immediately.
+        bool HasRetiredObjects() const noexcept { return m_pHead.load(std::memory_order_relaxed) != nullptr; }
+
+    private:
+        // clang-format off
+        DeferredDeletionQueue(const DeferredDeletionQueue&) = delete;
+        DeferredDeletionQueue(DeferredDeletionQueue&&) = delete;
+        DeferredDeletionQueue& operator = (const DeferredDeletionQueue&) = delete;
+        DeferredDeletionQueue& operator = (DeferredDeletionQueue&&) = delete;
+        // clang-format on
+
+        // Top of the stack of retired objects, in reverse retire order
+        std::atomic<Node*> m_pHead{ nullptr };
+
+        struct DrainEntry
+        {
+            Node* pNode;
+
+            // Position in the stack, which is the reverse retire order. Sorting by it keeps the retire order
+            // within a type without a stable sort, which would allocate a buffer on every call.
+            size_t StackIndex;
+        };
+
+        // Reused by every Drain(), so that draining does not allocate in a steady state
+        std::vector<DrainEntry, STDAllocatorRawMem<DrainEntry>> m_DrainList;
+
+#ifdef QGFX_DEBUG
+        bool m_bDraining = false;
+#endif
+    };
+
+    /// Base class of objects that are destroyed by a DeferredDeletionQueue.
+
+    /// \tparam ObjectType - the most derived class, objects of the same ObjectType are destroyed together.
+    /// \tparam BaseType - the refcounted class ObjectType derives from.
+    ///
+    /// An object created with a null queue is deleted immediately, as any other refcounted object.
+    template <typename ObjectType, typename BaseType = IRefCountedObject>
+    class DeferredDeletionObject : public BaseType, private DeferredDeletionQueue::Node
+    {
+    protected:
+        template <typename... ArgTypes>
+        explicit DeferredDeletionObject(DeferredDeletionQueue* pDeletionQueue, ArgTypes&&... Args) :
+            BaseType{ std::forward<ArgTypes>(Args)... },
+            DeferredDeletionQueue::Node{ &DestroyRetired },
+            m_pDeletionQueue{ pDeletionQueue }
+        {
+        }
+
+        virtual void DeleteThis() override
+        {
+            if (m_pDeletionQueue != nullptr)
+                m_pDeletionQueue->Retire(this);
+            else
+                BaseType::DeleteThis();
+        }
+
+    private:
+        static void DestroyRetired(DeferredDeletionQueue::Node* pNode)
+        {
+            static_cast<DeferredDeletionObject*>(pNode)->BaseType::DeleteThis();
+        }
+
+        DeferredDeletionQueue* const m_pDeletionQueue;
+    };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Align.hpp"
+#include "Error.hpp"
+
+#include "../Platform/Atomics.hpp"
+
+namespace Qgfx
+{
+    // Epoch based reclamation for structures that are read without a lock.
+    //
+    // Readers enter a read section before they load pointers into the structure and leave it when they no longer
+    // use them. A writer that unlinks an object retires it tagged with the current epoch, and frees it only once
+    // IsReclaimable() says that no reader can still hold it. The epoch only moves forward when no reader is left
+    // in the epoch before the current one, so an object retired in epoch E is unreachable once the epoch is E + 2.
+    //
+    // Readers count themselves in one of NumStripes cache line sized stripes picked by GetCurrentThreadIndex(),
+    // the same as ReaderWriterLock, so readers on different threads do not take a cache line from each other.
+    // Entering and leaving never wait on a writer. Writers must serialize their calls to TryAdvance() themselves,
+    // which the structures using this class do with the lock they already hold for writing.
+    class EpochManager
+    {
+    public:
+        /// Number of reader count stripes. A power of two.
+        static constexpr uint32_t NumStripes = 16;
+
+        EpochManager() noexcept;
+
+        /// Enters a read section and returns the token to pass to Leave()
+        uint32_t Enter() noexcept;
+
+        void Leave(uint32_t Token) noexcept;
+
+        Int64 GetEpoch() const noexcept
+        {
+            return Atomics::Load(m_Epoch, MemoryOrder::eAcquire);
+        }
+
+        /// Moves to the next epoch unless a reader is still in the previous one, returns whether it did.
+        /// Calls must not overlap.
+        bool TryAdvance() noexcept;
+
+        /// Whether no reader can reach an object any more that was retired when the epoch was RetireEpoch
+        bool IsReclaimable(Int64 RetireEpoch) const noexcept
+        {
+            return GetEpoch() >= RetireEpoch + 2;
+        }
+
+    private:
+        // clang-format off
+        EpochManager(const EpochManager&) = delete;
+        EpochManager(EpochManager&&) = delete;
+        EpochManager& operator = (const EpochManager&) = delete;
+        EpochManager& operator = (EpochManager&&) = delete;
+        // clang-format on
+
+        /// Readers are counted by the epoch they entered modulo 3, which is enough to tell
+        /// the current epoch, the one before it and the one being drained apart
+        static constexpr uint32_t NumEpochSlots = 3;
+
+        struct alignas(CacheLineSize) Stripe
+        {
+            AtomicLong NumReaders[NumEpochSlots];
+        };
+
+        Stripe m_Stripes[NumStripes];
+
+        // Loaded by every reader, so it gets a cache line of its own
+        alignas(CacheLineSize) mutable AtomicInt64 m_Epoch;
+    };
+
+    /// Holds a read section of an EpochManager for its lifetime
+    class EpochGuard
+    {
+    public:
+        explicit EpochGuard(EpochManager& Manager) noexcept :
+            m_Manager{ Manager },
+            m_Token{ Manager.Enter() }
+        {
+        }
+
+        ~EpochGuard()
+        {
+            m_Manager.Leave(m_Token);
+        }
+
+        EpochGuard(const EpochGuard&) = delete;
+        EpochGuard& operator=(const EpochGuard&) = delete;
+
+    private:
+        EpochManager&  m_Manager;
+        const uint32_t m_Token;
+    };
+}
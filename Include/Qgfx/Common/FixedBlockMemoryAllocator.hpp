@@ -1,15 +1,16 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
 #include <mutex>
-#include <unordered_set>
-#include <vector>
+#include <new>
 #include <cstring>
 #include <memory>
 #include <cstdint>
 
+#include "Align.hpp"
 #include "Error.hpp"
 #include "MemoryAllocator.hpp"
+#include "SpinLock.hpp"
 #include "STDAllocator.hpp"
 
 namespace Qgfx
@@ -17,15 +18,96 @@ namespace Qgfx
     class FixedBlockMemoryAllocator final : public IMemoryAllocator
     {
     public:
-        FixedBlockMemoryAllocator(IMemoryAllocator& RawMemoryAllocator, size_t BlockSize, uint32_t NumBlocksInPage);
+        /// Default number of free blocks a thread cache may hold before it returns a batch to the pages.
+        static constexpr uint32_t DefaultThreadCacheSize = 32;
+
+        /// Default number of empty pages kept around instead of being returned to the raw allocator.
+        static constexpr uint32_t DefaultMaxSparePages = 1;
+
+        /// \param [in] RawMemoryAllocator - allocator used to allocate memory pages.
+        /// \param [in] BlockSize - size of every block returned by the allocator. Blocks are aligned to the largest
+        ///                         power of two that divides the block size, up to CacheLineSize, so e.g. 64-byte
+        ///                         blocks are cache line aligned.
+        /// \param [in] NumBlocksInPage - minimum number of blocks in a single memory page. Pages are sized to
+        ///                               a power of two, and any space left over is used for extra blocks.
+        /// \param [in] ThreadCacheSize - maximum number of free blocks kept in each thread cache.
+        ///                               Zero disables thread caches, so every call takes the page lock.
+        /// \param [in] MaxSparePages - maximum number of empty pages that are kept for reuse. Pages that become
+        ///                             empty beyond this number are returned to the raw allocator right away.
+        FixedBlockMemoryAllocator(IMemoryAllocator& RawMemoryAllocator,
+                                  size_t            BlockSize,
+                                  uint32_t          NumBlocksInPage,
+                                  uint32_t          ThreadCacheSize = DefaultThreadCacheSize,
+                                  uint32_t          MaxSparePages = DefaultMaxSparePages);
         ~FixedBlockMemoryAllocator();
 
         /// Allocates block of memory
         virtual void* Allocate(size_t Size) override final;
 
+        /// Allocates block of memory. Alignment must not exceed GetBlockAlignment().
+        virtual void* Allocate(size_t Size, size_t Alignment) override final;
+
         /// Releases memory
         virtual void Free(void* Ptr) override final;
 
+        /// Allocates Count blocks and writes their addresses to ppBlocks.
+
+        /// Blocks are taken from the thread cache first, and the rest come from the pages under a single
+        /// lock, so the cost of a burst grows with the number of pages it touches rather than with Count.
+        void AllocateBatch(uint32_t Count, void** ppBlocks);
+
+        /// Releases Count blocks whose addresses are in ppBlocks. The page lock is taken at most once.
+        void FreeBatch(uint32_t Count, void* const* ppBlocks);
+
+        /// Returns all blocks held by the thread caches to their memory pages.
+        void FlushThreadCaches();
+
+        /// Flushes the thread caches and returns empty pages to the raw allocator.
+
+        /// \param [in] NumSparePagesToKeep - number of empty pages that are not released.
+        /// \return Number of bytes returned to the raw allocator.
+        ///
+        /// Call this after the load drops, e.g. after a scene transition, to give back
+        /// memory that was only needed at the peak.
+        size_t Trim(uint32_t NumSparePagesToKeep = 0);
+
+#if QGFX_MEMORY_STATISTICS
+        /// Counts blocks handed out by Allocate(). Blocks held in thread caches are not counted as live.
+        virtual MemoryStatistics* GetStatistics() override final { return &m_Statistics; }
+
+        /// Returns the tag that was current when the allocated block Ptr was handed out
+        MemoryTag GetBlockTag(const void* Ptr) const { return GetPage(Ptr)->GetBlockTag(Ptr); }
+#endif
+
+        struct PageStatistics
+        {
+            uint32_t NumPages = 0;
+            uint32_t NumEmptyPages = 0;
+            uint32_t NumBlocksInPage = 0;
+            size_t   PageSize = 0;
+        };
+
+        /// Returns the current number of pages. Blocks held in thread caches count as allocated.
+        PageStatistics GetPageStatistics();
+
+        size_t GetBlockSize() const { return m_BlockSize; }
+        size_t GetBlockAlignment() const { return m_BlockAlignment; }
+        size_t GetPageSize() const { return m_PageSize; }
+
+        /// Returns the number of bytes at the start of every page that are taken by the page header.
+        /// The header is padded to CacheLineSize, so the first block is cache line aligned.
+        static size_t GetPageHeaderSize();
+
+        /// Returns the allocator that owns the page containing Ptr.
+
+        /// Every page starts with a pointer to its owner, so several allocators that use the same page size
+        /// can tell which of them a block came from. Memory that does not come from a FixedBlockMemoryAllocator
+        /// may take part by starting its PageSize-aligned range with a null pointer.
+        static FixedBlockMemoryAllocator* GetBlockOwner(const void* Ptr, size_t PageSize)
+        {
+            return *reinterpret_cast<FixedBlockMemoryAllocator* const*>(AlignDown(Ptr, PageSize));
+        }
+
     private:
         // clang-format off
         FixedBlockMemoryAllocator(const FixedBlockMemoryAllocator&) = delete;
@@ -36,75 +118,130 @@ namespace Qgfx
 
         void CreateNewPage();
 
-#ifdef QGFX_DEBUG
-        void dbgVerifyAddress(const void* pBlockAddr) const
-        {
-            size_t Delta = reinterpret_cast<const uint8_t*>(pBlockAddr) - reinterpret_cast<uint8_t*>(m_pPageStart);
-            VERIFY(Delta % m_pOwnerAllocator->m_BlockSize == 0, "Invalid address");
-            uint32_t BlockIndex = static_cast<uint32_t>(Delta / m_pOwnerAllocator->m_BlockSize);
-            QGFX_VERIFY(BlockIndex >= 0 && BlockIndex < m_pOwnerAllocator->m_NumBlocksInPage, "Invalid block index");
-        }
+#if QGFX_MEMORY_STATISTICS
+        // Count the block under the current memory tag, and under the tag it was allocated with
+        void RecordBlockAllocation(void* Ptr);
+        void RecordBlockFree(void* Ptr);
+#endif
+
+        // The following methods must be called while m_Mutex is locked
+        void AllocateFromPages(uint32_t Count, void** ppBlocks);
+        void FreeToPages(uint32_t Count, void* const* ppBlocks);
 
-        inline void dbgFillPattern(void* ptr, uint8_t Pattern, size_t NumBytes)
+#ifdef QGFX_DEBUG
+        static void dbgFillPattern(void* ptr, uint8_t Pattern, size_t NumBytes)
         {
             memset(ptr, Pattern, NumBytes);
         }
 #else
-#    define dbgFillPattern(...)
-#    define dbgVerifyAddress(...)
+        static void dbgFillPattern(void*, uint8_t, size_t) {}
 #endif
 
+        // Thread caches (magazines) sit in front of the pages. Every thread is assigned
+        // one of NumThreadCaches slots, so as long as there are no more active threads than
+        // slots, the cache lock is never contended and its cache line is never shared.
+        // Blocks only move between a cache and the pages in batches of m_ThreadCacheSize / 2,
+        // which is the only time m_Mutex is taken.
+        static constexpr uint32_t NumThreadCaches = 32;
+
+        // Thread caches are moved to and from the pages through an array of this many blocks on the stack
+        static constexpr uint32_t MaxBlocksPerTransfer = 64;
+
+        struct alignas(CacheLineSize) ThreadCache
+        {
+            SpinLockFlag LockFlag;
+            uint32_t     NumBlocks = 0;
+            void*        pFirstBlock = nullptr; // Blocks are linked through their first pointer-sized word
+        };
+
+        ThreadCache& GetThreadCache();
+
+        void RefillThreadCache(ThreadCache& Cache);
+        void DrainThreadCache(ThreadCache& Cache, uint32_t NumBlocksToKeep);
+
         // Memory page class is based on the fixed-size memory pool described in "Fast Efficient Fixed-Size Memory Pool"
         // by Ben Kenwright
+        //
+        // Every page occupies m_PageSize bytes aligned to m_PageSize, and the MemoryPage object itself
+        // lives at the start of that range, followed by the blocks:
+        //
+        // Pages are allocated from the raw allocator with m_PageSize alignment.
+        //
+        //   m_PageSize aligned
+        //   |
+        //   V
+        //   | MemoryPage | Block 0 | Block 1 | ... | Block m_NumBlocksInPage - 1 |
+        //
+        // The page that owns a block is therefore found by aligning the block address down to m_PageSize.
         class MemoryPage
         {
+            // Must be the first member, GetBlockOwner() reads it without knowing the page layout
+            FixedBlockMemoryAllocator* m_pOwnerAllocator = nullptr;
+
         public:
             static constexpr uint8_t NewPageMemPattern = 0xAA;
             static constexpr uint8_t AllocatedBlockMemPattern = 0xAB;
             static constexpr uint8_t DeallocatedBlockMemPattern = 0xDE;
             static constexpr uint8_t InitializedBlockMemPattern = 0xCF;
 
-            MemoryPage(FixedBlockMemoryAllocator& OwnerAllocator) :
-                // clang-format off
-                m_NumFreeBlocks{ OwnerAllocator.m_NumBlocksInPage },
-                m_NumInitializedBlocks{ 0 },
-                m_pOwnerAllocator{ &OwnerAllocator }
-                // clang-format on
+#ifdef QGFX_DEBUG
+            void dbgVerifyAddress(const void* pBlockAddr) const
             {
-                auto PageSize = OwnerAllocator.m_BlockSize * OwnerAllocator.m_NumBlocksInPage;
-                m_pPageStart = reinterpret_cast<uint8_t*>(
-                    OwnerAllocator.m_RawMemoryAllocator.Allocate(PageSize));
-                m_pNextFreeBlock = m_pPageStart;
-                dbgFillPattern(m_pPageStart, NewPageMemPattern, PageSize);
+                size_t Delta = reinterpret_cast<const uint8_t*>(pBlockAddr) - reinterpret_cast<const uint8_t*>(GetBlockStartAddress(0));
+                QGFX_VERIFY(Delta % m_pOwnerAllocator->m_BlockSize == 0, "Invalid address");
+                uint32_t BlockIndex = static_cast<uint32_t>(Delta / m_pOwnerAllocator->m_BlockSize);
+                QGFX_VERIFY(BlockIndex >= 0 && BlockIndex < m_pOwnerAllocator->m_NumBlocksInPage, "Invalid block index");
             }
 
-            MemoryPage(MemoryPage&& Page) noexcept :
-                // clang-format off
-                m_NumFreeBlocks{ Page.m_NumFreeBlocks },
-                m_NumInitializedBlocks{ Page.m_NumInitializedBlocks },
-                m_pPageStart{ Page.m_pPageStart },
-                m_pNextFreeBlock{ Page.m_pNextFreeBlock },
-                m_pOwnerAllocator{ Page.m_pOwnerAllocator }
-                // clang-format on
+            void dbgVerifyNotFree(const void* pBlockAddr) const
             {
-                Page.m_NumFreeBlocks = 0;
-                Page.m_NumInitializedBlocks = 0;
-                Page.m_pPageStart = nullptr;
-                Page.m_pNextFreeBlock = nullptr;
-                Page.m_pOwnerAllocator = nullptr;
+                // Only initialized blocks are linked into the free list
+                const uint32_t NumInitializedFreeBlocks = m_NumFreeBlocks - (m_pOwnerAllocator->m_NumBlocksInPage - m_NumInitializedBlocks);
+                const void*    pFreeBlock = m_pNextFreeBlock;
+                for (uint32_t i = 0; i < NumInitializedFreeBlocks; ++i)
+                {
+                    QGFX_VERIFY(pFreeBlock != pBlockAddr, "Block is already free - double freeing memory?");
+                    pFreeBlock = *reinterpret_cast<void* const*>(pFreeBlock);
+                }
             }
+#else
+            void dbgVerifyAddress(const void*) const {}
+            void dbgVerifyNotFree(const void*) const {}
+#endif
 
-            ~MemoryPage()
+            static MemoryPage* Create(FixedBlockMemoryAllocator& OwnerAllocator)
             {
-                if (m_pOwnerAllocator)
-                    m_pOwnerAllocator->m_RawMemoryAllocator.Free(m_pPageStart);
+                const size_t PageSize = OwnerAllocator.m_PageSize;
+                void*        pPageStart = OwnerAllocator.m_RawMemoryAllocator.Allocate(PageSize, PageSize);
+                dbgFillPattern(pPageStart, NewPageMemPattern, PageSize);
+                MemoryPage* pPage = new (pPageStart) MemoryPage{ OwnerAllocator };
+#if QGFX_MEMORY_STATISTICS
+                // Kept outside of the page, so that the page layout does not depend on the statistics
+                pPage->m_pBlockTags = reinterpret_cast<MemoryTag*>(OwnerAllocator.m_RawMemoryAllocator.Allocate(sizeof(MemoryTag) * OwnerAllocator.m_NumBlocksInPage, alignof(MemoryTag)));
+#endif
+                return pPage;
+            }
+
+            static void Destroy(MemoryPage* pPage)
+            {
+                IMemoryAllocator& RawMemoryAllocator = pPage->m_pOwnerAllocator->m_RawMemoryAllocator;
+#if QGFX_MEMORY_STATISTICS
+                RawMemoryAllocator.Free(pPage->m_pBlockTags);
+#endif
+                pPage->~MemoryPage();
+                RawMemoryAllocator.Free(pPage);
+            }
+
+            uint32_t GetBlockIndex(const void* pBlockAddr) const
+            {
+                return static_cast<uint32_t>((reinterpret_cast<const uint8_t*>(pBlockAddr) - reinterpret_cast<const uint8_t*>(this) - m_pOwnerAllocator->m_FirstBlockOffset) / m_pOwnerAllocator->m_BlockSize);
             }
 
             void* GetBlockStartAddress(uint32_t BlockIndex) const
             {
                 QGFX_VERIFY_EXPR(m_pOwnerAllocator != nullptr);
                 QGFX_VERIFY(BlockIndex >= 0 && BlockIndex < m_pOwnerAllocator->m_NumBlocksInPage, "Invalid block index");
-                return reinterpret_cast<uint8_t*>(m_pPageStart) + BlockIndex * m_pOwnerAllocator->m_BlockSize;
+                return const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(this)) + m_pOwnerAllocator->m_FirstBlockOffset + BlockIndex * m_pOwnerAllocator->m_BlockSize;
             }
 
             void* Allocate()
@@ -160,11 +297,21 @@ namespace Qgfx
                 return res;
             }
 
+            /// Allocates up to Count blocks and returns the number of blocks allocated
+            uint32_t AllocateBatch(uint32_t Count, void** ppBlocks)
+            {
+                const uint32_t NumBlocks = std::min(Count, m_NumFreeBlocks);
+                for (uint32_t i = 0; i < NumBlocks; ++i)
+                    ppBlocks[i] = Allocate();
+                return NumBlocks;
+            }
+
             void Deallocate(void* p)
             {
                 QGFX_VERIFY_EXPR(m_pOwnerAllocator != nullptr);
 
                 dbgVerifyAddress(p);
+                dbgVerifyNotFree(p);
                 dbgFillPattern(p, DeallocatedBlockMemPattern, m_pOwnerAllocator->m_BlockSize);
                 // Add block to the beginning of the linked list
                 *reinterpret_cast<void**>(p) = m_pNextFreeBlock;
@@ -172,32 +319,85 @@ namespace Qgfx
                 ++m_NumFreeBlocks;
             }
 
+#if QGFX_MEMORY_STATISTICS
+            // Every block's tag is only written by the thread that allocates the block and read by the one that
+            // frees it, which the caller already orders, so the tags need no lock
+            MemoryTag GetBlockTag(const void* pBlockAddr) const { return m_pBlockTags[GetBlockIndex(pBlockAddr)]; }
+            void      SetBlockTag(const void* pBlockAddr, MemoryTag Tag) { m_pBlockTags[GetBlockIndex(pBlockAddr)] = Tag; }
+#endif
+
             bool HasSpace() const { return m_NumFreeBlocks > 0; }
-            bool HasAllocations() const { return m_NumFreeBlocks < m_NumInitializedBlocks; }
+            bool HasAllocations() const { return m_NumFreeBlocks < m_pOwnerAllocator->m_NumBlocksInPage; }
+
+            FixedBlockMemoryAllocator* GetOwner() const { return m_pOwnerAllocator; }
+
+            // Intrusive list of all pages owned by the allocator
+            MemoryPage* m_pPrevPage = nullptr;
+            MemoryPage* m_pNextPage = nullptr;
+
+            // Intrusive list of pages that have free blocks. A page is in this list if and only if HasSpace() is true.
+            MemoryPage* m_pPrevAvailablePage = nullptr;
+            MemoryPage* m_pNextAvailablePage = nullptr;
 
         private:
+            MemoryPage(FixedBlockMemoryAllocator& OwnerAllocator) :
+                // clang-format off
+                m_pOwnerAllocator{ &OwnerAllocator },
+                m_NumFreeBlocks{ OwnerAllocator.m_NumBlocksInPage },
+                m_NumInitializedBlocks{ 0 }
+                // clang-format on
+            {
+                m_pNextFreeBlock = GetBlockStartAddress(0);
+            }
+
+            ~MemoryPage() = default;
+
             MemoryPage(const MemoryPage&) = delete;
-            MemoryPage& operator=(const MemoryPage) = delete;
+            MemoryPage(MemoryPage&&) = delete;
+            MemoryPage& operator=(const MemoryPage&) = delete;
             MemoryPage& operator=(MemoryPage&&) = delete;
 
-            uint32_t                     m_NumFreeBlocks = 0;       // Num of remaining blocks
-            uint32_t                     m_NumInitializedBlocks = 0;       // Num of initialized blocks
-            void* m_pPageStart = nullptr; // Beginning of memory pool
-            void* m_pNextFreeBlock = nullptr; // Num of next free block
-            FixedBlockMemoryAllocator* m_pOwnerAllocator = nullptr;
+            uint32_t m_NumFreeBlocks = 0;          // Num of remaining blocks
+            uint32_t m_NumInitializedBlocks = 0;   // Num of initialized blocks
+            void*    m_pNextFreeBlock = nullptr;   // Num of next free block
+#if QGFX_MEMORY_STATISTICS
+            MemoryTag* m_pBlockTags = nullptr;     // Tag of every block, indexed by block index
+#endif
         };
 
-        std::vector<MemoryPage, STDAllocatorRawMem<MemoryPage>>                                          m_PagePool;
-        std::unordered_set<size_t, std::hash<size_t>, std::equal_to<size_t>, STDAllocatorRawMem<size_t>> m_AvailablePages;
+        MemoryPage* GetPage(const void* Ptr) const
+        {
+            return reinterpret_cast<MemoryPage*>(AlignDown(reinterpret_cast<uintptr_t>(Ptr), static_cast<uintptr_t>(m_PageSize)));
+        }
+
+        void AddAvailablePage(MemoryPage* pPage);
+        void RemoveAvailablePage(MemoryPage* pPage);
+        void ReleasePage(MemoryPage* pPage);
 
-        using AddrToPageIdMapElem = std::pair<void* const, size_t>;
-        std::unordered_map<void*, size_t, std::hash<void*>, std::equal_to<void*>, STDAllocatorRawMem<AddrToPageIdMapElem>> m_AddrToPageId;
+        MemoryPage* m_pFirstPage = nullptr;
+        MemoryPage* m_pFirstAvailablePage = nullptr;
+
+        uint32_t m_NumPages = 0;
+
+        // Number of pages that have no allocated blocks
+        uint32_t m_NumEmptyPages = 0;
 
         std::mutex m_Mutex;
 
         IMemoryAllocator& m_RawMemoryAllocator;
         const size_t      m_BlockSize;
+        const size_t      m_BlockAlignment;
+        const size_t      m_FirstBlockOffset;
+        const size_t      m_PageSize;
         const uint32_t    m_NumBlocksInPage;
+        const uint32_t    m_ThreadCacheSize;
+        const uint32_t    m_MaxSparePages;
+
+        ThreadCache m_ThreadCaches[NumThreadCaches];
+
+#if QGFX_MEMORY_STATISTICS
+        MemoryStatistics m_Statistics;
+#endif
     };
 
 
@@ -0,0 +1,459 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QGFX_HASH_CONTROL_GROUP_SSE2 1
+#include <emmintrin.h>
+#else
+#define QGFX_HASH_CONTROL_GROUP_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "Align.hpp"
+#include "Error.hpp"
+#include "MemoryAllocator.hpp"
+
+namespace Qgfx
+{
+    /// Sixteen control bytes of a Swiss table, compared against a value all at once.
+
+    /// Every slot of the table has a control byte. A full slot holds the low 7 bits of the slot's hash (H2), free
+    /// slots are Empty or Deleted, which both have the high bit set. Lookups first find the slots of a group whose
+    /// control byte matches, and only look at those, so most slots that do not hold the key are never touched.
+    ///
+    /// The bytes are passed as two 64-bit words, byte i of the group being bits [8 * (i % 8), 8 * (i % 8) + 8) of
+    /// word i / 8. That way tables that are read concurrently can load a group with two atomic loads.
+    class HashControlGroup
+    {
+    public:
+        static constexpr uint32_t Width = 16;
+
+        static constexpr uint8_t Empty = 0x80;
+        static constexpr uint8_t Deleted = 0xFE;
+
+        HashControlGroup(uint64_t Lo, uint64_t Hi) noexcept :
+#if QGFX_HASH_CONTROL_GROUP_SSE2
+            m_Control{ _mm_set_epi64x(static_cast<long long>(Hi), static_cast<long long>(Lo)) }
+#else
+            m_Control{ Lo, Hi }
+#endif
+        {
+        }
+
+        /// Bit i is set if control byte i equals Control
+        uint32_t Match(uint8_t Control) const noexcept
+        {
+#if QGFX_HASH_CONTROL_GROUP_SSE2
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(m_Control, _mm_set1_epi8(static_cast<char>(Control)))));
+#else
+            uint32_t Mask = 0;
+            for (uint32_t i = 0; i < Width; ++i)
+            {
+                if (GetControlByte(m_Control[i / 8], i % 8) == Control)
+                    Mask |= 1u << i;
+            }
+            return Mask;
+#endif
+        }
+
+        uint32_t MatchEmpty() const noexcept
+        {
+            return Match(Empty);
+        }
+
+        uint32_t MatchEmptyOrDeleted() const noexcept
+        {
+#if QGFX_HASH_CONTROL_GROUP_SSE2
+            // Exactly the free states have the high bit set
+            return static_cast<uint32_t>(_mm_movemask_epi8(m_Control));
+#else
+            uint32_t Mask = 0;
+            for (uint32_t i = 0; i < Width; ++i)
+            {
+                if (GetControlByte(m_Control[i / 8], i % 8) & 0x80)
+                    Mask |= 1u << i;
+            }
+            return Mask;
+#endif
+        }
+
+        static bool IsFull(uint8_t Control) noexcept
+        {
+            return (Control & 0x80) == 0;
+        }
+
+        /// Control byte of a full slot with the hash
+        static uint8_t GetH2(uint64_t Hash) noexcept
+        {
+            return static_cast<uint8_t>(Hash & 0x7F);
+        }
+
+        /// Bits of the hash that select the first group to probe
+        static uint64_t GetH1(uint64_t Hash) noexcept
+        {
+            return Hash >> 7;
+        }
+
+        /// Spreads the bits of a std::hash value over the whole word, as std::hash of an integer is often the integer itself
+        static uint64_t MixHash(size_t Hash) noexcept
+        {
+            const uint64_t Product = static_cast<uint64_t>(Hash) * 0x9E3779B97F4A7C15ull;
+            return Product ^ (Product >> 32);
+        }
+
+        static uint8_t GetControlByte(uint64_t Word, uint32_t ByteIndex) noexcept
+        {
+            return static_cast<uint8_t>(Word >> (ByteIndex * 8));
+        }
+
+        static uint64_t SetControlByte(uint64_t Word, uint32_t ByteIndex, uint8_t Control) noexcept
+        {
+            const uint32_t Shift = ByteIndex * 8;
+            return (Word & ~(uint64_t{ 0xFF } << Shift)) | (static_cast<uint64_t>(Control) << Shift);
+        }
+
+        /// Index of the lowest set bit of a non-zero match mask
+        static uint32_t GetLowestMatch(uint32_t Mask) noexcept
+        {
+            QGFX_VERIFY_EXPR(Mask != 0);
+#if defined(_MSC_VER)
+            unsigned long Index;
+            _BitScanForward(&Index, Mask);
+            return static_cast<uint32_t>(Index);
+#else
+            return static_cast<uint32_t>(__builtin_ctz(Mask));
+#endif
+        }
+
+    private:
+#if QGFX_HASH_CONTROL_GROUP_SSE2
+        __m128i m_Control;
+#else
+        uint64_t m_Control[2];
+#endif
+    };
+
+    /// Open addressing hash map laid out as a Swiss table.
+
+    /// Elements are stored in place in one array, together with their full 64-bit hash, and a separate array of
+    /// control bytes (see HashControlGroup) is probed sixteen slots at a time. A lookup usually reads one group
+    /// of control bytes and one slot, and compares keys only when the stored hashes are equal. Inserting or
+    /// erasing an element may move the other elements, so pointers to values are only valid until the next change.
+    ///
+    /// The map is not thread safe.
+    template <typename KeyType, typename ValueType, typename HashType = std::hash<KeyType>, typename KeyEqualType = std::equal_to<KeyType>>
+    class FlatHashMap
+    {
+    public:
+        explicit FlatHashMap(IMemoryAllocator& RawAllocator) noexcept :
+            m_RawAllocator{ RawAllocator }
+        {
+        }
+
+        ~FlatHashMap()
+        {
+            Clear();
+            if (m_pControl != nullptr)
+                m_RawAllocator.Free(m_pControl);
+        }
+
+        size_t GetSize() const noexcept { return m_Size; }
+
+        bool IsEmpty() const noexcept { return m_Size == 0; }
+
+        /// Returns the value of the key, or null if the map does not contain it
+        ValueType* Find(const KeyType& Key)
+        {
+            if (m_NumGroups == 0)
+                return nullptr;
+
+            const uint64_t Hash = HashControlGroup::MixHash(HashType{}(Key));
+            const uint8_t  H2 = HashControlGroup::GetH2(Hash);
+
+            uint32_t Group = static_cast<uint32_t>(HashControlGroup::GetH1(Hash)) & (m_NumGroups - 1);
+            for (uint32_t Step = 1;; ++Step)
+            {
+                const HashControlGroup Control = LoadGroup(Group);
+                for (uint32_t Mask = Control.Match(H2); Mask != 0; Mask &= Mask - 1)
+                {
+                    Slot& Candidate = m_pSlots[Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(Mask)];
+                    if (Candidate.Hash == Hash && KeyEqualType{}(Candidate.Key, Key))
+                        return &Candidate.Value;
+                }
+
+                // A probe sequence never passes a group with an empty slot, so the key is not further on
+                if (Control.MatchEmpty() != 0)
+                    return nullptr;
+
+                // Triangular steps visit every group of a power of two number of groups
+                Group = (Group + Step) & (m_NumGroups - 1);
+            }
+        }
+
+        /// Inserts the key with a value constructed from Args unless the map already contains the key.
+        /// Returns the value of the key and whether it was inserted.
+        template <typename... ArgsType>
+        std::pair<ValueType*, bool> Emplace(const KeyType& Key, ArgsType&&... Args)
+        {
+            const uint64_t Hash = HashControlGroup::MixHash(HashType{}(Key));
+            const uint8_t  H2 = HashControlGroup::GetH2(Hash);
+
+            // Look for the key and for the first free slot of its probe sequence in the same pass
+            uint32_t Index = InvalidIndex;
+            if (m_NumGroups != 0)
+            {
+                uint32_t Group = static_cast<uint32_t>(HashControlGroup::GetH1(Hash)) & (m_NumGroups - 1);
+                for (uint32_t Step = 1;; ++Step)
+                {
+                    const HashControlGroup Control = LoadGroup(Group);
+                    for (uint32_t Mask = Control.Match(H2); Mask != 0; Mask &= Mask - 1)
+                    {
+                        Slot& Candidate = m_pSlots[Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(Mask)];
+                        if (Candidate.Hash == Hash && KeyEqualType{}(Candidate.Key, Key))
+                            return { &Candidate.Value, false };
+                    }
+
+                    if (Index == InvalidIndex)
+                    {
+                        const uint32_t FreeMask = Control.MatchEmptyOrDeleted();
+                        if (FreeMask != 0)
+                            Index = Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(FreeMask);
+                    }
+
+                    if (Control.MatchEmpty() != 0)
+                        break;
+
+                    Group = (Group + Step) & (m_NumGroups - 1);
+                }
+            }
+
+            // A deleted slot can be reused as it is, an empty one uses up room
+            if (Index == InvalidIndex || (m_GrowthLeft == 0 && GetControl(Index) == HashControlGroup::Empty))
+            {
+                RehashForInsertion();
+                Index = FindFreeSlot(Hash);
+            }
+            if (GetControl(Index) == HashControlGroup::Empty)
+                --m_GrowthLeft;
+
+            Slot* pSlot = new (&m_pSlots[Index]) Slot(Hash, Key, std::forward<ArgsType>(Args)...);
+            SetControl(Index, H2);
+            ++m_Size;
+            return { &pSlot->Value, true };
+        }
+
+        /// Removes the key, returns whether the map contained it
+        bool Erase(const KeyType& Key)
+        {
+            ValueType* pValue = Find(Key);
+            if (pValue == nullptr)
+                return false;
+
+            EraseSlot(static_cast<uint32_t>(GetSlot(pValue) - m_pSlots));
+            return true;
+        }
+
+        /// Removes the elements for which Predicate(const KeyType&, ValueType&) returns true, returns their number
+        template <typename PredicateType>
+        size_t EraseIf(PredicateType&& Predicate)
+        {
+            size_t NumErased = 0;
+            for (uint32_t i = 0; i < GetCapacity(); ++i)
+            {
+                if (HashControlGroup::IsFull(GetControl(i)) && Predicate(static_cast<const KeyType&>(m_pSlots[i].Key), m_pSlots[i].Value))
+                {
+                    EraseSlot(i);
+                    ++NumErased;
+                }
+            }
+            return NumErased;
+        }
+
+        /// Calls Function(const KeyType&, ValueType&) for every element
+        template <typename FunctionType>
+        void ForEach(FunctionType&& Function)
+        {
+            for (uint32_t i = 0; i < GetCapacity(); ++i)
+            {
+                if (HashControlGroup::IsFull(GetControl(i)))
+                    Function(static_cast<const KeyType&>(m_pSlots[i].Key), m_pSlots[i].Value);
+            }
+        }
+
+        /// Removes all elements and keeps the memory
+        void Clear()
+        {
+            for (uint32_t i = 0; i < GetCapacity(); ++i)
+            {
+                if (HashControlGroup::IsFull(GetControl(i)))
+                    m_pSlots[i].~Slot();
+            }
+            ResetControl();
+            m_Size = 0;
+            m_GrowthLeft = GetMaxUsedSlots(m_NumGroups);
+        }
+
+        /// Makes room for NumElements elements, so that inserting them does not rehash
+        void Reserve(size_t NumElements)
+        {
+            if (NumElements <= m_Size + m_GrowthLeft)
+                return;
+
+            uint32_t NumGroups = 1;
+            while (GetMaxUsedSlots(NumGroups) < NumElements)
+                NumGroups *= 2;
+            Rehash(NumGroups);
+        }
+
+    private:
+        // clang-format off
+        FlatHashMap(const FlatHashMap&) = delete;
+        FlatHashMap(FlatHashMap&&) = delete;
+        FlatHashMap& operator = (const FlatHashMap&) = delete;
+        FlatHashMap& operator = (FlatHashMap&&) = delete;
+        // clang-format on
+
+        struct Slot
+        {
+            template <typename... ArgsType>
+            Slot(uint64_t InHash, const KeyType& InKey, ArgsType&&... Args) :
+                Hash{ InHash },
+                Key(InKey),
+                Value(std::forward<ArgsType>(Args)...)
+            {}
+
+            uint64_t  Hash;
+            KeyType   Key;
+            ValueType Value;
+        };
+
+        static Slot* GetSlot(ValueType* pValue)
+        {
+            return reinterpret_cast<Slot*>(reinterpret_cast<uint8_t*>(pValue) - offsetof(Slot, Value));
+        }
+
+        static constexpr uint32_t InvalidIndex = ~0u;
+
+        uint32_t GetCapacity() const noexcept { return m_NumGroups * HashControlGroup::Width; }
+
+        /// At most 7/8 of the slots are used, counting deleted ones, so that every probe sequence ends
+        static size_t GetMaxUsedSlots(uint32_t NumGroups) { return NumGroups * HashControlGroup::Width / 8 * 7; }
+
+        HashControlGroup LoadGroup(uint32_t Group) const
+        {
+            return HashControlGroup{ m_pControl[Group * 2], m_pControl[Group * 2 + 1] };
+        }
+
+        uint8_t GetControl(uint32_t Index) const
+        {
+            return HashControlGroup::GetControlByte(m_pControl[Index / 8], Index % 8);
+        }
+
+        void SetControl(uint32_t Index, uint8_t Control)
+        {
+            m_pControl[Index / 8] = HashControlGroup::SetControlByte(m_pControl[Index / 8], Index % 8, Control);
+        }
+
+        void ResetControl()
+        {
+            for (uint32_t i = 0; i < m_NumGroups * 2; ++i)
+                m_pControl[i] = 0x8080808080808080ull;
+        }
+
+        /// Returns the first empty or deleted slot of the hash's probe sequence
+        uint32_t FindFreeSlot(uint64_t Hash) const
+        {
+            uint32_t Group = static_cast<uint32_t>(HashControlGroup::GetH1(Hash)) & (m_NumGroups - 1);
+            for (uint32_t Step = 1;; ++Step)
+            {
+                const uint32_t Mask = LoadGroup(Group).MatchEmptyOrDeleted();
+                if (Mask != 0)
+                    return Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(Mask);
+                Group = (Group + Step) & (m_NumGroups - 1);
+            }
+        }
+
+        void EraseSlot(uint32_t Index)
+        {
+            m_pSlots[Index].~Slot();
+            --m_Size;
+
+            // If the group still has an empty slot, no probe sequence has ever run through it, and the slot can
+            // become empty again. Otherwise it must stay used, so that the sequences running through it continue.
+            if (LoadGroup(Index / HashControlGroup::Width).MatchEmpty() != 0)
+            {
+                SetControl(Index, HashControlGroup::Empty);
+                ++m_GrowthLeft;
+            }
+            else
+                SetControl(Index, HashControlGroup::Deleted);
+        }
+
+        /// Makes room for one more element once the empty slots have run out. The table is rebuilt at the same
+        /// size when deleted slots make up enough of it, and doubled otherwise, so that erasing and inserting at
+        /// a steady size rehashes only after a number of insertions proportional to the capacity.
+        void RehashForInsertion()
+        {
+            if (m_NumGroups == 0)
+                Rehash(1);
+            else if (m_Size <= size_t{ GetCapacity() } * 25 / 32)
+                Rehash(m_NumGroups);
+            else
+                Rehash(m_NumGroups * 2);
+        }
+
+        /// Moves the elements to new arrays of NumGroups groups, which also drops the deleted slots
+        void Rehash(uint32_t NumGroups)
+        {
+            QGFX_VERIFY_EXPR(GetMaxUsedSlots(NumGroups) >= m_Size);
+
+            const size_t SlotsOffset = AlignUp(sizeof(uint64_t) * NumGroups * 2, alignof(Slot));
+            uint8_t*     pMemory = reinterpret_cast<uint8_t*>(m_RawAllocator.Allocate(SlotsOffset + sizeof(Slot) * NumGroups * HashControlGroup::Width, alignof(Slot) > alignof(uint64_t) ? alignof(Slot) : alignof(uint64_t)));
+
+            uint64_t* const pOldControl = m_pControl;
+            Slot* const     pOldSlots = m_pSlots;
+            const uint32_t  OldCapacity = GetCapacity();
+
+            m_pControl = reinterpret_cast<uint64_t*>(pMemory);
+            m_pSlots = reinterpret_cast<Slot*>(pMemory + SlotsOffset);
+            m_NumGroups = NumGroups;
+            m_GrowthLeft = GetMaxUsedSlots(NumGroups);
+            ResetControl();
+
+            for (uint32_t i = 0; i < OldCapacity; ++i)
+            {
+                if (!HashControlGroup::IsFull(HashControlGroup::GetControlByte(pOldControl[i / 8], i % 8)))
+                    continue;
+
+                Slot&          OldSlot = pOldSlots[i];
+                const uint32_t Index = FindFreeSlot(OldSlot.Hash);
+                new (&m_pSlots[Index]) Slot(std::move(OldSlot));
+                SetControl(Index, HashControlGroup::GetH2(OldSlot.Hash));
+                --m_GrowthLeft;
+                OldSlot.~Slot();
+            }
+
+            if (pOldControl != nullptr)
+                m_RawAllocator.Free(pOldControl);
+        }
+
+        IMemoryAllocator& m_RawAllocator;
+
+        /// Two words of control bytes per group, followed by the slots in the same allocation
+        uint64_t* m_pControl = nullptr;
+        Slot*     m_pSlots = nullptr;
+        uint32_t  m_NumGroups = 0;
+        size_t    m_Size = 0;
+
+        /// Number of empty slots that can be used before the map must rehash
+        size_t m_GrowthLeft = 0;
+    };
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Error.hpp"
+#include "SpinLock.hpp"
+
+namespace Qgfx
+{
+    class HybridLock;
+
+    class HybridLockFlag
+    {
+    public:
+        enum State : uint32_t
+        {
+            Unlocked = 0,
+            Locked = 1,
+            LockedWithWaiters = 2 // Some thread may be parked, so Unlock() must wake one
+        };
+
+        /// Guard type that locks this flag, so code can be written against either lock flag
+        using LockType = HybridLock;
+
+        HybridLockFlag() noexcept {}
+
+        operator uint32_t() const { return m_State.load(); }
+
+    private:
+        friend class HybridLock;
+
+        // Waited on directly by the operating system, so it must be a plain 32-bit integer
+        std::atomic<uint32_t> m_State{ Unlocked };
+    };
+
+    // Lock that spins for a short while and then parks the thread in the kernel (a futex on Linux,
+    // WaitOnAddress() on Windows) until the holder wakes it. Unlike SpinLock, a waiter does not burn
+    // CPU time while the holder is preempted, which matters when there are more threads than cores.
+    // The uncontended lock and unlock are a single atomic operation each, the same as SpinLock.
+    class HybridLock
+    {
+    public:
+        /// Number of pauses a thread spins for before it parks
+        static constexpr const int DefaultSpinCount = 128;
+
+        HybridLock() noexcept {}
+
+        HybridLock(HybridLockFlag& LockFlag) noexcept
+        {
+            Lock(LockFlag);
+        }
+
+        HybridLock(HybridLock&& Lock) noexcept :
+            m_pLockFlag{ Lock.m_pLockFlag }
+        {
+            Lock.m_pLockFlag = nullptr;
+        }
+
+        HybridLock(const HybridLock& Lock) = delete;
+
+        HybridLock& operator=(const HybridLock& Lock) = delete;
+
+        HybridLock& operator=(HybridLock&& Lock) noexcept
+        {
+            m_pLockFlag = Lock.m_pLockFlag;
+            Lock.m_pLockFlag = nullptr;
+            return *this;
+        }
+
+        ~HybridLock()
+        {
+            Unlock();
+        }
+
+        static bool UnsafeTryLock(HybridLockFlag& LockFlag) noexcept
+        {
+            uint32_t Expected = HybridLockFlag::Unlocked;
+            return LockFlag.m_State.compare_exchange_strong(Expected, HybridLockFlag::Locked, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        bool TryLock(HybridLockFlag& LockFlag) noexcept
+        {
+            QGFX_VERIFY(m_pLockFlag == nullptr, "Object already locked");
+            if (UnsafeTryLock(LockFlag))
+            {
+                m_pLockFlag = &LockFlag;
+                return true;
+            }
+            return false;
+        }
+
+        static void UnsafeLock(HybridLockFlag& LockFlag, int SpinCount = DefaultSpinCount) noexcept
+        {
+            if (!UnsafeTryLock(LockFlag))
+                LockContended(LockFlag, SpinCount);
+        }
+
+        void Lock(HybridLockFlag& LockFlag, int SpinCount = DefaultSpinCount) noexcept
+        {
+            QGFX_VERIFY(m_pLockFlag == nullptr, "Object already locked");
+            UnsafeLock(LockFlag, SpinCount);
+            m_pLockFlag = &LockFlag;
+        }
+
+        static void UnsafeUnlock(HybridLockFlag& LockFlag) noexcept
+        {
+            // Release, so that the critical section cannot leak past the unlock
+            if (LockFlag.m_State.exchange(HybridLockFlag::Unlocked, std::memory_order_release) == HybridLockFlag::LockedWithWaiters)
+                WakeWaiter(LockFlag);
+        }
+
+        void Unlock() noexcept
+        {
+            if (m_pLockFlag)
+                UnsafeUnlock(*m_pLockFlag);
+            m_pLockFlag = nullptr;
+        }
+
+    private:
+        static void LockContended(HybridLockFlag& LockFlag, int SpinCount) noexcept;
+
+        // Blocks while the flag holds Value. May return spuriously.
+        static void Park(HybridLockFlag& LockFlag, uint32_t Value) noexcept;
+
+        static void WakeWaiter(HybridLockFlag& LockFlag) noexcept;
+
+        HybridLockFlag* m_pLockFlag = nullptr;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "HybridLock.hpp"
 #include "SpinLock.hpp"
 #include "MemoryAllocator.hpp"
 #include "TypeCompatibleBytes.hpp"
@@ -11,17 +12,120 @@
 #include <memory>
 #include <type_traits>
 
+#ifdef QGFX_DEBUG
+#include <thread>
+#endif
+
 namespace Qgfx
 {
-    class IWeakRefCounter;
+    /**
+     * @brief Threading policy for objects that may be referenced from any thread. Counts are updated with atomic instructions.
+    */
+    struct MultiThreaded
+    {
+        using CounterType = AtomicLong;
+        using LockFlagType = SpinLockFlag;
+        using LockType = SpinLock;
+
+        static Long Increment(CounterType& Counter, MemoryOrder Order) { return Atomics::Increment(Counter, Order); }
+        static Long Decrement(CounterType& Counter, MemoryOrder Order) { return Atomics::Decrement(Counter, Order); }
+        static Long Load(CounterType& Counter, MemoryOrder Order) { return Atomics::Load(Counter, Order); }
+        static Long Add(CounterType& Counter, Long Value) { return Atomics::Add(Counter, Value); }
+
+        static Long CompareExchange(CounterType& Counter, Long Exchange, Long Comparand, MemoryOrder Order)
+        {
+            return Atomics::CompareExchange(Counter, Exchange, Comparand, Order);
+        }
+
+        static void ThreadFence(MemoryOrder Order) { Atomics::ThreadFence(Order); }
+
+        class ThreadCheck
+        {
+        protected:
+            void VerifyOwnerThread() const {}
+        };
+    };
+
+    /**
+     * @brief Same as MultiThreaded, but threads that race to create the weak ref counter park on a HybridLock
+     * instead of spinning.
+    */
+    struct MultiThreadedHybridLock : MultiThreaded
+    {
+        using LockFlagType = HybridLockFlag;
+        using LockType = HybridLock;
+    };
+
+    /**
+     * @brief Threading policy for objects that never leave the thread that created them, such as per-thread
+     * command buffers. Counts are plain integers, and debug builds verify every reference is taken and
+     * released on the creating thread.
+    */
+    struct SingleThreaded
+    {
+        using CounterType = Long;
+
+        struct LockFlagType {};
+
+        struct LockType
+        {
+            LockType(LockFlagType&) noexcept {}
+        };
+
+        static Long Increment(CounterType& Counter, MemoryOrder) { return ++Counter; }
+        static Long Decrement(CounterType& Counter, MemoryOrder) { return --Counter; }
+        static Long Load(CounterType& Counter, MemoryOrder) { return Counter; }
+        static Long Add(CounterType& Counter, Long Value) { return Counter += Value; }
+
+        static Long CompareExchange(CounterType& Counter, Long Exchange, Long Comparand, MemoryOrder)
+        {
+            const Long Prev = Counter;
+            if (Prev == Comparand)
+                Counter = Exchange;
+            return Prev;
+        }
+
+        static void ThreadFence(MemoryOrder) {}
+
+        class ThreadCheck
+        {
+        protected:
+#ifdef QGFX_DEBUG
+            void VerifyOwnerThread() const
+            {
+                QGFX_VERIFY(m_OwnerThreadId == std::this_thread::get_id(), "Single-threaded object is referenced from a thread other than the one that created it");
+            }
+
+        private:
+            std::thread::id m_OwnerThreadId = std::this_thread::get_id();
+#else
+            void VerifyOwnerThread() const {}
+#endif
+        };
+    };
+
+    template <typename ThreadingPolicy>
+    class WeakRefCounter;
+
+    /**
+     * @brief Returns the allocator all weak ref counters are allocated from.
+     *
+     * Counters are small and created once for every object a registry tracks, so they are packed into
+     * the pages of a dedicated fixed block allocator instead of each taking a separate heap allocation.
+    */
+    IMemoryAllocator& GetWeakRefCounterAllocator();
 
     /**
      * @brief Represents an intrusively refcounted object.
+     * @tparam ThreadingPolicy MultiThreaded, or SingleThreaded for objects confined to the thread that created them.
     */
-    class IRefCountedObject
+    template <typename ThreadingPolicy>
+    class RefCountedObject : private ThreadingPolicy::ThreadCheck
     {
     public:
 
+        using RefCountPolicy = ThreadingPolicy;
+
         /**
          * @brief This function increments the ref count of the object by one.
         */
@@ -39,13 +143,13 @@ namespace Qgfx
         */
         Long GetRefCount();
 
-        IWeakRefCounter* AddWeakRef();
+        WeakRefCounter<ThreadingPolicy>* AddWeakRef();
 
     protected:
 
-        IRefCountedObject();
+        RefCountedObject();
 
-        virtual ~IRefCountedObject() = default;
+        virtual ~RefCountedObject() = default;
 
         // Override in extended class to provide custom deleter.
         virtual void DeleteThis()
@@ -55,85 +159,148 @@ namespace Qgfx
 
     private:
 
-        AtomicLong m_RefCount;
+        friend WeakRefCounter<ThreadingPolicy>;
+
+        /**
+         * @brief Increments the ref count unless it has already dropped to zero.
+         * @return True if a reference was added.
+        */
+        bool TryAddRef();
+
+        typename ThreadingPolicy::CounterType m_RefCount;
 
-        // Gates access to m_pWeakRefCounter
-        SpinLockFlag m_WeakRefCounterSpinFlag;
-        IWeakRefCounter* m_pWeakRefCounter; // nullptr if AddWeakRef() is never called
+        // Gates creation of m_pWeakRefCounter
+        typename ThreadingPolicy::LockFlagType m_WeakRefCounterSpinFlag;
+        WeakRefCounter<ThreadingPolicy>* m_pWeakRefCounter; // nullptr if AddWeakRef() is never called
     };
 
-    class IWeakRefCounter
+    /**
+     * @brief Control block shared by all weak references to an object.
+     *
+     * The object holds one weak reference to its counter until it is deleted, so the counter outlives
+     * the object. None of the operations take a lock: Lock() only increments the strong ref count if it
+     * has not dropped to zero, and the object is not deleted while a Lock() call may still touch it.
+    */
+    template <typename ThreadingPolicy>
+    class WeakRefCounter
     {
     public:
 
         void AddWeakRef()
         {
-            Atomics::Increment(m_WeakRefCount);
+            // A new reference can only be made from an existing one, so nothing needs to be ordered
+            ThreadingPolicy::Increment(m_WeakRefCount, MemoryOrder::eRelaxed);
         }
 
         void ReleaseWeakRef()
         {
-            SpinLock Lock{ m_RefCountedObjectSpinFlag };
-
-            auto WeakRefCount = Atomics::Decrement(m_WeakRefCount);
+            auto WeakRefCount = ThreadingPolicy::Decrement(m_WeakRefCount, MemoryOrder::eRelease);
             QGFX_VERIFY(WeakRefCount >= 0, "Inconsistent call to ReleaseWeakRef()");
-            // RefCountedObject holds a weak reference until destroyed, so checking this also checks whether or not the managed object is still alive.
-            if (WeakRefCount == 0 && m_pRefCountedObject == nullptr)
+            // The object holds a weak reference until it is deleted, so the last weak reference
+            // is only released once the object is gone and nothing can reach the counter anymore.
+            if (WeakRefCount == 0)
             {
-                Lock.Unlock();
-
+                ThreadingPolicy::ThreadFence(MemoryOrder::eAcquire);
                 DeleteThis();
             }
         }
 
-        void Lock(IRefCountedObject** ppObject)
+        /**
+         * @brief Obtains a strong reference to the object.
+         * @return The object with its ref count incremented, or nullptr if it has been released.
+        */
+        RefCountedObject<ThreadingPolicy>* Lock()
         {
-            SpinLock Lock{ m_RefCountedObjectSpinFlag };
+            RefCountedObject<ThreadingPolicy>* pObject = nullptr;
 
-            if (m_pRefCountedObject == nullptr)
+            // Once the released flag is set the object may be deleted at any moment, so it must not be touched
+            if ((BeginAccess() & ObjectReleasedFlag) == 0 && m_pRefCountedObject->TryAddRef())
             {
-                *ppObject = nullptr;
-                return;
+                pObject = m_pRefCountedObject;
             }
 
-            // Ensures that Lock is not called when ref count is zero
+            EndAccess();
 
-            m_pRefCountedObject->AddRef();
+            return pObject;
+        }
 
-            if (m_pRefCountedObject->GetRefCount() > 1)
+        /**
+         * @brief Returns the strong ref count of the object, or zero if it has been released.
+         * @note The value may be out of date by the time it is returned, unless it is zero.
+        */
+        Long GetNumStrongRefs()
+        {
+            Long NumStrongRefs = 0;
+            if ((BeginAccess() & ObjectReleasedFlag) == 0)
             {
-                *ppObject = m_pRefCountedObject;
-                return;
+                NumStrongRefs = m_pRefCountedObject->GetRefCount();
             }
-            
-            m_pRefCountedObject->Release();
+
+            EndAccess();
+
+            return NumStrongRefs;
         }
-        
 
     private:
 
-        friend IRefCountedObject;
+        friend RefCountedObject<ThreadingPolicy>;
 
-        IWeakRefCounter(IRefCountedObject* pRefCountedObject)
-            : m_pRefCountedObject(pRefCountedObject), m_WeakRefCount(1)
+        // m_AccessState holds the number of Lock() and GetNumStrongRefs() calls that are in progress,
+        // and these two flags. Whoever brings the number to zero after ObjectReleasedFlag is set sets
+        // ObjectDeletedFlag and deletes the object.
+        static constexpr Long ObjectReleasedFlag = Long{ 1 } << 29;
+        static constexpr Long ObjectDeletedFlag = Long{ 1 } << 30;
+
+        WeakRefCounter(RefCountedObject<ThreadingPolicy>* pRefCountedObject)
+            : m_WeakRefCount(1), m_AccessState(0), m_pRefCountedObject(pRefCountedObject)
         {
         }
 
-        ~IWeakRefCounter()
+        ~WeakRefCounter()
         {
         }
 
-        void IndicateObjectDestroyed()
+        static void* operator new(size_t Size)
         {
-            SpinLock Lock{ m_RefCountedObjectSpinFlag };
+            return GetWeakRefCounterAllocator().Allocate(Size);
+        }
 
-            m_pRefCountedObject = nullptr;
+        static void operator delete(void* Ptr)
+        {
+            GetWeakRefCounterAllocator().Free(Ptr);
+        }
 
-            if (Atomics::Load(m_WeakRefCount) == 0)
+        Long BeginAccess()
+        {
+            return ThreadingPolicy::Increment(m_AccessState, MemoryOrder::eSequentiallyConsistent);
+        }
+
+        void EndAccess()
+        {
+            if (ThreadingPolicy::Decrement(m_AccessState, MemoryOrder::eSequentiallyConsistent) == ObjectReleasedFlag)
             {
-                Lock.Unlock();
+                TryDeleteObject();
+            }
+        }
 
-                DeleteThis();
+        // Called once the strong ref count of the object has dropped to zero
+        void IndicateObjectReleased()
+        {
+            if (ThreadingPolicy::Add(m_AccessState, ObjectReleasedFlag) == ObjectReleasedFlag)
+            {
+                TryDeleteObject();
+            }
+        }
+
+        void TryDeleteObject()
+        {
+            // Both the thread that released the object and the last thread to leave Lock() may get here,
+            // but only one of them wins the exchange
+            if (ThreadingPolicy::CompareExchange(m_AccessState, ObjectReleasedFlag | ObjectDeletedFlag, ObjectReleasedFlag, MemoryOrder::eSequentiallyConsistent) == ObjectReleasedFlag)
+            {
+                m_pRefCountedObject->DeleteThis();
+                // Release the weak reference held by the object
+                ReleaseWeakRef();
             }
         }
 
@@ -142,61 +309,94 @@ namespace Qgfx
             delete this;
         }
 
-        Atomics::AtomicLong m_WeakRefCount;
+        typename ThreadingPolicy::CounterType m_WeakRefCount;
+        typename ThreadingPolicy::CounterType m_AccessState;
 
-        // Gates access to m_pRefCountedObject
-        SpinLockFlag m_RefCountedObjectSpinFlag;
-        IRefCountedObject* m_pRefCountedObject;
+        // Never changes, but may only be dereferenced between BeginAccess() and EndAccess()
+        RefCountedObject<ThreadingPolicy>* const m_pRefCountedObject;
 
     };
 
-    inline void IRefCountedObject::AddRef()
+    /**
+     * @brief Base class of objects that may be referenced from any thread.
+    */
+    using IRefCountedObject = RefCountedObject<MultiThreaded>;
+    using IWeakRefCounter = WeakRefCounter<MultiThreaded>;
+
+    template <typename ThreadingPolicy>
+    inline void RefCountedObject<ThreadingPolicy>::AddRef()
     {
-        Atomics::Increment(m_RefCount);
+        this->VerifyOwnerThread();
+        // A new reference can only be made from an existing one, so nothing needs to be ordered
+        ThreadingPolicy::Increment(m_RefCount, MemoryOrder::eRelaxed);
     }
 
-    inline void IRefCountedObject::Release()
+    template <typename ThreadingPolicy>
+    inline bool RefCountedObject<ThreadingPolicy>::TryAddRef()
     {
-        auto RefCount = Atomics::Decrement(m_RefCount);
+        this->VerifyOwnerThread();
+        Long RefCount = ThreadingPolicy::Load(m_RefCount, MemoryOrder::eRelaxed);
+        while (RefCount > 0)
+        {
+            const Long PrevRefCount = ThreadingPolicy::CompareExchange(m_RefCount, RefCount + 1, RefCount, MemoryOrder::eAcquire);
+            if (PrevRefCount == RefCount)
+                return true;
+            RefCount = PrevRefCount;
+        }
+        return false;
+    }
+
+    template <typename ThreadingPolicy>
+    inline void RefCountedObject<ThreadingPolicy>::Release()
+    {
+        this->VerifyOwnerThread();
+        // Every release publishes the writes made through the reference, and the thread that
+        // destroys the object acquires all of them before it runs the destructor
+        auto RefCount = ThreadingPolicy::Decrement(m_RefCount, MemoryOrder::eRelease);
         QGFX_VERIFY(RefCount >= 0, "Inconsistent call to Release()");
         if (RefCount == 0)
         {
-            // This block can only ever be called once, so no spin lock is necessary
+            ThreadingPolicy::ThreadFence(MemoryOrder::eAcquire);
+
+            // This block can only ever be called once, and AddWeakRef() requires a strong
+            // reference, so m_pWeakRefCounter can no longer change
 
             if (m_pWeakRefCounter)
             {
-                m_pWeakRefCounter->IndicateObjectDestroyed();
+                // The counter deletes the object once no Lock() call can touch it anymore
+                m_pWeakRefCounter->IndicateObjectReleased();
+                return;
             }
 
             DeleteThis();
         }
     }
 
-    inline Long IRefCountedObject::GetRefCount()
+    template <typename ThreadingPolicy>
+    inline Long RefCountedObject<ThreadingPolicy>::GetRefCount()
     {
-        return Atomics::Load(m_RefCount);
+        return ThreadingPolicy::Load(m_RefCount, MemoryOrder::eRelaxed);
     }
 
-    inline IWeakRefCounter* IRefCountedObject::AddWeakRef()
+    template <typename ThreadingPolicy>
+    inline WeakRefCounter<ThreadingPolicy>* RefCountedObject<ThreadingPolicy>::AddWeakRef()
     {
-        SpinLock Lock{ m_WeakRefCounterSpinFlag };
+        this->VerifyOwnerThread();
+        typename ThreadingPolicy::LockType Lock{ m_WeakRefCounterSpinFlag };
 
         if (m_pWeakRefCounter == nullptr)
         {
-            // m_pWeakRefCounter starts with one weak reference
-            m_pWeakRefCounter = new IWeakRefCounter(this);
-        }
-        else
-        {
-            m_pWeakRefCounter->AddWeakRef();
+            // The counter starts with the weak reference held by the object, plus the one being added
+            m_pWeakRefCounter = new WeakRefCounter<ThreadingPolicy>(this);
         }
 
-        Lock.Unlock();
+        m_pWeakRefCounter->AddWeakRef();
 
         return m_pWeakRefCounter;
     }
 
-    inline IRefCountedObject::IRefCountedObject()
+    template <typename ThreadingPolicy>
+    inline RefCountedObject<ThreadingPolicy>::RefCountedObject()
         : m_RefCount(1), m_pWeakRefCounter(nullptr)
     {
     }
@@ -352,7 +552,59 @@ namespace Qgfx
 	private:
 
 		template <typename OtherType>
-		friend class RefPtrPtr;
+		friend class RefPtr;
+
+		T* m_pObject = nullptr;
+	};
+
+	/**
+	 * @brief Non-owning pointer to a refcounted object.
+	 *
+	 * Borrowing a pointer never touches the ref count, so short lookups such as ICommandBuffer::BorrowQueue() do not
+	 * pay for an AddRef()/Release() pair on a shared cache line. The caller must know that something else keeps the
+	 * object alive for as long as the pointer is used, typically the object it was borrowed from. Construct a RefPtr
+	 * from it to keep the object.
+	*/
+	template<typename T>
+	class BorrowedPtr
+	{
+	public:
+
+		BorrowedPtr() noexcept {}
+
+		explicit BorrowedPtr(T* pObj) noexcept
+			: m_pObject{ pObj }
+		{
+		}
+
+		BorrowedPtr(const RefPtr<T>& Ptr) noexcept
+			: m_pObject{ const_cast<T*>(Ptr.Raw()) }
+		{
+		}
+
+		template <typename DerivedType, typename = typename std::enable_if<std::is_base_of<T, DerivedType>::value>::type>
+		BorrowedPtr(const BorrowedPtr<DerivedType>& Other) noexcept
+			: m_pObject{ Other.Raw() }
+		{
+		}
+
+		bool operator!() const noexcept { return m_pObject == nullptr; }
+		explicit operator bool() const noexcept { return m_pObject != nullptr; }
+		bool operator==(const BorrowedPtr& Other) const noexcept { return m_pObject == Other.m_pObject; }
+		bool operator!=(const BorrowedPtr& Other) const noexcept { return m_pObject != Other.m_pObject; }
+
+		T& operator*() const noexcept { return *m_pObject; }
+		T* operator->() const noexcept { return m_pObject; }
+		operator T* () const noexcept { return m_pObject; }
+
+		T* Raw() const noexcept { return m_pObject; }
+
+		/**
+		 * @brief Takes a strong reference to the object.
+		*/
+		RefPtr<T> Lock() const { return RefPtr<T>{ m_pObject }; }
+
+	private:
 
 		T* m_pObject = nullptr;
 	};
@@ -361,7 +613,9 @@ namespace Qgfx
        class WeakPtr
        {
 
-           static_assert(std::is_base_of<IRefCountedObject, T>::value, "T must extend Qgfx::IRefCountedObject to be used in Qgfx::WeakPtr");
+           using RefCountPolicy = typename T::RefCountPolicy;
+
+           static_assert(std::is_base_of<RefCountedObject<RefCountPolicy>, T>::value, "T must extend Qgfx::RefCountedObject to be used in Qgfx::WeakPtr");
 
        public:
            explicit WeakPtr(T* pObj = nullptr) noexcept 
@@ -443,14 +697,16 @@ namespace Qgfx
            /// Obtains a strong reference to the object
            void Lock(T** ppObject)
            {
+               *ppObject = m_pRefCounter ? static_cast<T*>(m_pRefCounter->Lock()) : nullptr;
+           }
+
+           /// Obtains a strong reference to the object, or an empty pointer if the object has been destroyed
+           RefPtr<T> Lock()
+           {
+               RefPtr<T> pObject;
                if (m_pRefCounter)
-               {
-                   m_pRefCounter->Lock(ppObject);
-               }
-               else
-               {
-                   *ppObject = nullptr;
-               }
+                   pObject.Attach(static_cast<T*>(m_pRefCounter->Lock()));
+               return pObject;
            }
 
            bool operator==(const WeakPtr& Ptr) const noexcept { return m_pRefCounter == Ptr.m_pRefCounter; }
@@ -458,7 +714,7 @@ namespace Qgfx
 
        protected:
 
-           IWeakRefCounter* m_pRefCounter;
+           WeakRefCounter<RefCountPolicy>* m_pRefCounter;
        };
 
 //	/**
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "Error.hpp"
+#include "MemoryAllocator.hpp"
+
+namespace Qgfx
+{
+    /// Bump-pointer arena for transient data that lives until the GPU has finished a submission.
+
+    /// Memory is handed out from large chunks by incrementing a pointer and is never freed one
+    /// allocation at a time. Every chunk is tagged with the current index (typically the index of
+    /// the submission being recorded), and ReleaseCompleted() recycles all chunks whose index has
+    /// completed. Chunks are kept for reuse, so in a steady state no memory is allocated at all.
+    ///
+    /// The allocator is not thread safe.
+    class LinearAllocator final : public IMemoryAllocator
+    {
+    public:
+        static constexpr size_t DefaultChunkSize = 65536;
+
+        /// \param [in] RawMemoryAllocator - allocator used to allocate chunks.
+        /// \param [in] ChunkSize - size of a regular chunk. Larger requests get a dedicated chunk.
+        LinearAllocator(IMemoryAllocator& RawMemoryAllocator, size_t ChunkSize = DefaultChunkSize);
+        ~LinearAllocator();
+
+        /// Allocates block of memory aligned to alignof(std::max_align_t)
+        virtual void* Allocate(size_t Size) override final;
+
+        /// Allocates block of memory aligned to Alignment
+        virtual void* Allocate(size_t Size, size_t Alignment) override final;
+
+        /// Does nothing, memory is reclaimed by ReleaseCompleted()
+        virtual void Free(void* /*Ptr*/) override final {}
+
+        /// Allocates an uninitialized array of Count elements, or returns nullptr if Count is zero.
+        template <typename T>
+        T* AllocateArray(size_t Count)
+        {
+            static_assert(std::is_trivially_destructible<T>::value, "Destructors of arena objects are never called");
+            return Count != 0 ? reinterpret_cast<T*>(Allocate(sizeof(T) * Count, alignof(T))) : nullptr;
+        }
+
+        /// Sets the index that chunks used by subsequent allocations are tagged with. Indices must not decrease.
+        void SetCurrentIndex(uint64_t Index);
+
+        /// Recycles all chunks that were last used by an index less than or equal to CompletedIndex.
+        void ReleaseCompleted(uint64_t CompletedIndex);
+
+        /// Returns recycled chunks that are not in use to the raw allocator.
+        void ReleaseUnusedChunks();
+
+    private:
+        // clang-format off
+        LinearAllocator(const LinearAllocator&) = delete;
+        LinearAllocator(LinearAllocator&&) = delete;
+        LinearAllocator& operator = (const LinearAllocator&) = delete;
+        LinearAllocator& operator = (LinearAllocator&&) = delete;
+        // clang-format on
+
+        struct Chunk
+        {
+            Chunk*   pNext;
+            uint64_t Index;  // Last index the chunk was used by
+            size_t   Size;   // Size of the data that follows the header
+        };
+
+        uint8_t* GetChunkData(Chunk* pChunk) const { return reinterpret_cast<uint8_t*>(pChunk) + m_ChunkHeaderSize; }
+
+        Chunk* CreateChunk(size_t DataSize);
+        void   DestroyChunk(Chunk* pChunk);
+        void   RetireChunk(Chunk* pChunk);
+        void   BeginChunk(Chunk* pChunk);
+
+        IMemoryAllocator& m_RawMemoryAllocator;
+        const size_t      m_ChunkSize;
+        const size_t      m_ChunkHeaderSize;
+
+        uint64_t m_CurrentIndex = 0;
+
+        // Chunk that allocations are currently served from
+        Chunk*   m_pCurrentChunk = nullptr;
+        uint8_t* m_pCurrent = nullptr;
+        uint8_t* m_pEnd = nullptr;
+
+        // Chunks that may still be in use, in the order of their indices
+        Chunk* m_pFirstRetiredChunk = nullptr;
+        Chunk* m_pLastRetiredChunk = nullptr;
+
+        // Regular-sized chunks that are ready for reuse
+        Chunk* m_pFirstFreeChunk = nullptr;
+    };
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "HybridLock.hpp"
+#include "ReaderWriterLock.hpp"
+#include "SpinLock.hpp"
+
+#include "../Platform/Atomics.hpp"
+
+namespace Qgfx
+{
+    /// Statistics of one named lock, see GetLockProfile().
+    struct LockProfile
+    {
+        static constexpr uint32_t NumHoldTimeBuckets = 32;
+
+        const char* Name = nullptr;
+
+        Int64 NumAcquisitions = 0;
+
+        /// Number of acquisitions that found the lock taken and had to wait
+        Int64 NumContendedAcquisitions = 0;
+
+        Int64 TotalWaitNs = 0;
+        Int64 MaxWaitNs = 0;
+        Int64 TotalHoldNs = 0;
+
+        /// Number of times the lock was held for [2^i, 2^(i+1)) ns. The last bucket also counts all longer holds.
+        Int64 HoldTimeHistogram[NumHoldTimeBuckets] = {};
+    };
+
+    /// A place in the code that takes a named lock. Sites are static objects created by QGFX_LOCK_GUARD()
+    /// and QGFX_SHARED_LOCK_GUARD() when QGFX_LOCK_PROFILING is enabled. They live until the process exits.
+    class LockSite
+    {
+    public:
+        explicit LockSite(const char* Name);
+
+        void RecordAcquisition(bool bContended, Int64 WaitNs);
+        void RecordRelease(Int64 HoldNs);
+
+        static Int64 GetTimestampNs();
+
+    private:
+        friend std::vector<LockProfile> GetLockProfile();
+        friend void ResetLockProfile();
+
+        // clang-format off
+        LockSite(const LockSite&) = delete;
+        LockSite(LockSite&&) = delete;
+        LockSite& operator = (const LockSite&) = delete;
+        LockSite& operator = (LockSite&&) = delete;
+        // clang-format on
+
+        const char* const m_Name;
+
+        /// Next site in the list of all sites
+        LockSite* m_pNextSite = nullptr;
+
+        AtomicInt64 m_NumAcquisitions{ 0 };
+        AtomicInt64 m_NumContendedAcquisitions{ 0 };
+        AtomicInt64 m_TotalWaitNs{ 0 };
+        AtomicInt64 m_MaxWaitNs{ 0 };
+        AtomicInt64 m_TotalHoldNs{ 0 };
+        AtomicInt64 m_HoldTimeHistogram[LockProfile::NumHoldTimeBuckets] = {};
+    };
+
+    /// Returns the statistics of all lock sites that have been entered so far, one entry per lock name,
+    /// the locks that were waited for the longest first. Returns nothing unless QGFX_LOCK_PROFILING is enabled.
+    std::vector<LockProfile> GetLockProfile();
+
+    /// Zeroes the statistics of all lock sites
+    void ResetLockProfile();
+
+    /// Describes how to lock each kind of lock the profiler supports, and which guard locks it normally
+    template <typename LockableType>
+    struct LockTraits;
+
+    template <>
+    struct LockTraits<std::mutex>
+    {
+        using GuardType = std::lock_guard<std::mutex>;
+
+        static bool TryLock(std::mutex& Mutex) { return Mutex.try_lock(); }
+        static void Lock(std::mutex& Mutex) { Mutex.lock(); }
+        static void Unlock(std::mutex& Mutex) { Mutex.unlock(); }
+    };
+
+    template <>
+    struct LockTraits<SpinLockFlag>
+    {
+        using GuardType = SpinLock;
+
+        static bool TryLock(SpinLockFlag& LockFlag) { return SpinLock::UnsafeTryLock(LockFlag); }
+        static void Lock(SpinLockFlag& LockFlag) { SpinLock::UnsafeLock(LockFlag); }
+        static void Unlock(SpinLockFlag& LockFlag) { SpinLock::UnsafeUnlock(LockFlag); }
+    };
+
+    template <>
+    struct LockTraits<HybridLockFlag>
+    {
+        using GuardType = HybridLock;
+
+        static bool TryLock(HybridLockFlag& LockFlag) { return HybridLock::UnsafeTryLock(LockFlag); }
+        static void Lock(HybridLockFlag& LockFlag) { HybridLock::UnsafeLock(LockFlag); }
+        static void Unlock(HybridLockFlag& LockFlag) { HybridLock::UnsafeUnlock(LockFlag); }
+    };
+
+    template <>
+    struct LockTraits<ReaderWriterLock>
+    {
+        using GuardType = WriteLock;
+
+        static bool TryLock(ReaderWriterLock& Lock) { return Lock.TryLock(); }
+        static void Lock(ReaderWriterLock& Lock) { Lock.Lock(); }
+        static void Unlock(ReaderWriterLock& Lock) { Lock.Unlock(); }
+    };
+
+    /// Same as LockTraits, for the shared side of the locks that have one
+    template <typename LockableType>
+    struct SharedLockTraits;
+
+    template <>
+    struct SharedLockTraits<ReaderWriterLock>
+    {
+        using GuardType = ReadLock;
+
+        static bool TryLock(ReaderWriterLock& Lock) { return Lock.TryLockShared(); }
+        static void Lock(ReaderWriterLock& Lock) { Lock.LockShared(); }
+        static void Unlock(ReaderWriterLock& Lock) { Lock.UnlockShared(); }
+    };
+
+    /// Guard that locks LockableType when lock profiling is disabled
+    template <typename LockableType>
+    using LockGuardType = typename LockTraits<LockableType>::GuardType;
+
+    template <typename LockableType>
+    using SharedLockGuardType = typename SharedLockTraits<LockableType>::GuardType;
+
+    /// Guard that holds a lock for its lifetime and reports the wait and the hold time to a LockSite.
+    /// A first try tells contended acquisitions apart, so an uncontended one costs a timestamp more than usual.
+    template <typename LockableType, typename TraitsType>
+    class ProfiledLockGuard
+    {
+    public:
+        ProfiledLockGuard(LockableType& Lockable, LockSite& Site) :
+            m_Lockable{ Lockable },
+            m_Site{ Site }
+        {
+            if (TraitsType::TryLock(m_Lockable))
+            {
+                m_AcquiredNs = LockSite::GetTimestampNs();
+                m_Site.RecordAcquisition(false, 0);
+            }
+            else
+            {
+                const Int64 WaitStartNs = LockSite::GetTimestampNs();
+                TraitsType::Lock(m_Lockable);
+                m_AcquiredNs = LockSite::GetTimestampNs();
+                m_Site.RecordAcquisition(true, m_AcquiredNs - WaitStartNs);
+            }
+        }
+
+        ~ProfiledLockGuard()
+        {
+            const Int64 HoldNs = LockSite::GetTimestampNs() - m_AcquiredNs;
+            TraitsType::Unlock(m_Lockable);
+            m_Site.RecordRelease(HoldNs);
+        }
+
+        ProfiledLockGuard(const ProfiledLockGuard&) = delete;
+        ProfiledLockGuard& operator=(const ProfiledLockGuard&) = delete;
+
+    private:
+        LockableType& m_Lockable;
+        LockSite&     m_Site;
+        Int64         m_AcquiredNs = 0;
+    };
+}
+
+#define QGFX_LOCK_PROFILING_CONCAT_IMPL(A, B) A##B
+#define QGFX_LOCK_PROFILING_CONCAT(A, B)      QGFX_LOCK_PROFILING_CONCAT_IMPL(A, B)
+
+#define QGFX_LOCKABLE_TYPE(Lockable) std::remove_cv_t<std::remove_reference_t<decltype(Lockable)>>
+
+/// Declares the guard variable Guard that holds Lockable until the end of the scope. With QGFX_LOCK_PROFILING the
+/// acquisitions are recorded under SiteName, otherwise this is the usual guard for the lock (std::lock_guard for
+/// std::mutex, SpinLock for SpinLockFlag and so on).
+/// QGFX_SHARED_LOCK_GUARD() is the same for the shared side of a ReaderWriterLock.
+
+#if QGFX_LOCK_PROFILING
+
+#define QGFX_PROFILED_LOCK_GUARD(Traits, Guard, Lockable, SiteName)                                                 \
+    static ::Qgfx::LockSite QGFX_LOCK_PROFILING_CONCAT(s_QgfxLockSite, __LINE__){ SiteName };                        \
+    ::Qgfx::ProfiledLockGuard<QGFX_LOCKABLE_TYPE(Lockable), ::Qgfx::Traits<QGFX_LOCKABLE_TYPE(Lockable)>> Guard      \
+    {                                                                                                                \
+        Lockable, QGFX_LOCK_PROFILING_CONCAT(s_QgfxLockSite, __LINE__)                                               \
+    }
+
+#define QGFX_LOCK_GUARD(Guard, Lockable, SiteName)        QGFX_PROFILED_LOCK_GUARD(LockTraits, Guard, Lockable, SiteName)
+
+#define QGFX_SHARED_LOCK_GUARD(Guard, Lockable, SiteName) QGFX_PROFILED_LOCK_GUARD(SharedLockTraits, Guard, Lockable, SiteName)
+
+#else
+
+#define QGFX_LOCK_GUARD(Guard, Lockable, SiteName)        ::Qgfx::LockGuardType<QGFX_LOCKABLE_TYPE(Lockable)> Guard{ Lockable }
+#define QGFX_SHARED_LOCK_GUARD(Guard, Lockable, SiteName) ::Qgfx::SharedLockGuardType<QGFX_LOCKABLE_TYPE(Lockable)> Guard{ Lockable }
+
+#endif
@@ -1,6 +1,15 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
 #include <type_traits>
+#include <utility>
+
+#include "Error.hpp"
+#include "MemoryStatistics.hpp"
 
 namespace Qgfx
 {
@@ -8,11 +17,21 @@ namespace Qgfx
 	{
 	public:
 
+		virtual ~IMemoryAllocator() = default;
+
 		/// Allocates block of memory
 		virtual void* Allocate(size_t Size) = 0;
 
-		/// Releases memory
+		/// Allocates block of memory aligned to Alignment, which must be a power of two
+		virtual void* Allocate(size_t Size, size_t Alignment) = 0;
+
+		/// Releases memory allocated by either Allocate() overload
 		virtual void Free(void* Ptr) = 0;
+
+#if QGFX_MEMORY_STATISTICS
+		/// Returns the allocation statistics of this allocator, or null if it does not collect any
+		virtual MemoryStatistics* GetStatistics() { return nullptr; }
+#endif
 	};
 
 	class DefaultRawMemoryAllocator final : public IMemoryAllocator
@@ -23,8 +42,14 @@ namespace Qgfx
 
 		virtual void* Allocate(size_t Size) override;
 
+		virtual void* Allocate(size_t Size, size_t Alignment) override;
+
 		virtual void Free(void* Ptr) override;
 
+#if QGFX_MEMORY_STATISTICS
+		virtual MemoryStatistics* GetStatistics() override { return &m_Statistics; }
+#endif
+
 		static DefaultRawMemoryAllocator& GetAllocator();
 
 	private:
@@ -32,6 +57,18 @@ namespace Qgfx
 		DefaultRawMemoryAllocator(DefaultRawMemoryAllocator&&) = delete;
 		DefaultRawMemoryAllocator& operator=(const DefaultRawMemoryAllocator&) = delete;
 		DefaultRawMemoryAllocator& operator=(DefaultRawMemoryAllocator&&) = delete;
+
+#if QGFX_MEMORY_STATISTICS
+		// Every allocation is prefixed with this header, which sits right before the returned pointer
+		struct AllocationHeader
+		{
+			size_t    Size;
+			uint32_t  Offset; // Distance from the start of the underlying allocation to the returned pointer
+			MemoryTag Tag;
+		};
+
+		MemoryStatistics m_Statistics;
+#endif
 	};
 
     template <typename T, typename AllocatorType>
@@ -69,13 +106,13 @@ namespace Qgfx
 
         T* allocate(std::size_t count)
         {
-            return reinterpret_cast<T*>(m_Allocator.Allocate(count * sizeof(T)));
+            return reinterpret_cast<T*>(m_Allocator.Allocate(count * sizeof(T), alignof(T)));
         }
 
         pointer       address(reference r) { return &r; }
         const_pointer address(const_reference r) { return &r; }
 
-        void deallocate(T* p, std::size_t count)
+        void deallocate(T* p, std::size_t /*count*/)
         {
             m_Allocator.Free(p);
         }
@@ -142,21 +179,30 @@ namespace Qgfx
         void operator()(T* ptr) noexcept
         {
             QGFX_VERIFY(m_Allocator != nullptr, "The deleter has been moved away or never initialized, and can't be used");
-            Destruct(ptr);
+            ptr->~T();
             m_Allocator->Free(ptr);
         }
 
     private:
         AllocatorType* m_Allocator = nullptr;
+    };
+    template <class T> using STDDeleterRawMem = STDDeleter<T, IMemoryAllocator>;
 
-        typename std::enable_if<std::is_destructible<T>::value, void>::type Destruct(T* ptr)
+    /// Constructs an object in memory obtained from Allocator with the alignment of T.
+    /// The returned pointer destroys the object and returns the memory to the same allocator.
+    template <class T, typename AllocatorType, typename... ArgTypes>
+    std::unique_ptr<T, STDDeleter<T, AllocatorType>> MakeUniqueWithAllocator(AllocatorType& Allocator, ArgTypes&&... Args)
+    {
+        void* pMemory = Allocator.Allocate(sizeof(T), alignof(T));
+        try
         {
-            ptr->~T();
+            T* pObject = new (pMemory) T(std::forward<ArgTypes>(Args)...);
+            return std::unique_ptr<T, STDDeleter<T, AllocatorType>>{ pObject, STDDeleter<T, AllocatorType>{ Allocator } };
         }
-
-        typename std::enable_if<!std::is_destructible<T>::value, void>::type Destruct(T* ptr)
+        catch (...)
         {
+            Allocator.Free(pMemory);
+            throw;
         }
-    };
-    template <class T> using STDDeleterRawMem = STDDeleter<T, IMemoryAllocator>;
+    }
 }
\ No newline at end of file
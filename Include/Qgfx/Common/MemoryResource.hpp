@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+#include "MemoryAllocator.hpp"
+
+namespace Qgfx
+{
+    /// Exposes an IMemoryAllocator as a std::pmr::memory_resource, so that std::pmr containers can
+    /// draw from Qgfx allocators.
+    class MemoryResourceAdapter final : public std::pmr::memory_resource
+    {
+    public:
+        explicit MemoryResourceAdapter(IMemoryAllocator& Allocator) noexcept :
+            m_Allocator{ Allocator }
+        {
+        }
+
+        IMemoryAllocator& GetAllocator() const { return m_Allocator; }
+
+    private:
+        virtual void* do_allocate(size_t Bytes, size_t Alignment) override;
+        virtual void  do_deallocate(void* Ptr, size_t Bytes, size_t Alignment) override;
+        virtual bool  do_is_equal(const std::pmr::memory_resource& Other) const noexcept override;
+
+        IMemoryAllocator& m_Allocator;
+    };
+
+    /// Exposes a std::pmr::memory_resource as an IMemoryAllocator.
+
+    /// std::pmr::memory_resource needs the size and alignment of a block to release it, so every
+    /// allocation is prefixed with a small header that records them.
+    class MemoryResourceAllocator final : public IMemoryAllocator
+    {
+    public:
+        explicit MemoryResourceAllocator(std::pmr::memory_resource* pResource = std::pmr::get_default_resource()) noexcept :
+            m_pResource{ pResource }
+        {
+        }
+
+        /// Allocates block of memory
+        virtual void* Allocate(size_t Size) override final;
+
+        /// Allocates block of memory aligned to Alignment
+        virtual void* Allocate(size_t Size, size_t Alignment) override final;
+
+        /// Releases memory
+        virtual void Free(void* Ptr) override final;
+
+        std::pmr::memory_resource* GetResource() const { return m_pResource; }
+
+    private:
+        struct AllocationHeader
+        {
+            size_t Size;      // Size passed to the resource, including the header
+            size_t Alignment; // Alignment passed to the resource
+        };
+
+        std::pmr::memory_resource* m_pResource;
+    };
+
+    /// Monotonic buffer resource that takes its chunks from a Qgfx allocator.
+
+    /// Memory is only released when the resource is destroyed or release() is called, which makes
+    /// it a good fit for scratch containers that live for the duration of a single function or frame.
+    class MonotonicMemoryResource final : public std::pmr::memory_resource
+    {
+    public:
+        explicit MonotonicMemoryResource(IMemoryAllocator& Upstream = DefaultRawMemoryAllocator::GetAllocator()) :
+            m_Upstream{ Upstream },
+            m_Resource{ &m_Upstream }
+        {
+        }
+
+        /// Starts with the memory in pBuffer (typically a stack array) and only goes to Upstream when that is exhausted.
+        MonotonicMemoryResource(void* pBuffer, size_t BufferSize, IMemoryAllocator& Upstream = DefaultRawMemoryAllocator::GetAllocator()) :
+            m_Upstream{ Upstream },
+            m_Resource{ pBuffer, BufferSize, &m_Upstream }
+        {
+        }
+
+        /// Releases all memory at once
+        void release() { m_Resource.release(); }
+
+    private:
+        MonotonicMemoryResource(const MonotonicMemoryResource&) = delete;
+        MonotonicMemoryResource& operator=(const MonotonicMemoryResource&) = delete;
+
+        virtual void* do_allocate(size_t Bytes, size_t Alignment) override { return m_Resource.allocate(Bytes, Alignment); }
+        virtual void  do_deallocate(void* Ptr, size_t Bytes, size_t Alignment) override { m_Resource.deallocate(Ptr, Bytes, Alignment); }
+        virtual bool  do_is_equal(const std::pmr::memory_resource& Other) const noexcept override { return this == &Other; }
+
+        MemoryResourceAdapter               m_Upstream;
+        std::pmr::monotonic_buffer_resource m_Resource;
+    };
+
+    /// Pool resource that takes its chunks from a Qgfx allocator.
+
+    /// \tparam PoolResourceType - std::pmr::unsynchronized_pool_resource or std::pmr::synchronized_pool_resource.
+    template <typename PoolResourceType>
+    class BasicPoolMemoryResource final : public std::pmr::memory_resource
+    {
+    public:
+        explicit BasicPoolMemoryResource(IMemoryAllocator& Upstream = DefaultRawMemoryAllocator::GetAllocator(), const std::pmr::pool_options& Options = {}) :
+            m_Upstream{ Upstream },
+            m_Resource{ Options, &m_Upstream }
+        {
+        }
+
+        /// Returns all memory to the upstream allocator
+        void release() { m_Resource.release(); }
+
+    private:
+        BasicPoolMemoryResource(const BasicPoolMemoryResource&) = delete;
+        BasicPoolMemoryResource& operator=(const BasicPoolMemoryResource&) = delete;
+
+        virtual void* do_allocate(size_t Bytes, size_t Alignment) override { return m_Resource.allocate(Bytes, Alignment); }
+        virtual void  do_deallocate(void* Ptr, size_t Bytes, size_t Alignment) override { m_Resource.deallocate(Ptr, Bytes, Alignment); }
+        virtual bool  do_is_equal(const std::pmr::memory_resource& Other) const noexcept override { return this == &Other; }
+
+        MemoryResourceAdapter m_Upstream;
+        PoolResourceType      m_Resource;
+    };
+
+    using PoolMemoryResource = BasicPoolMemoryResource<std::pmr::unsynchronized_pool_resource>;
+    using SynchronizedPoolMemoryResource = BasicPoolMemoryResource<std::pmr::synchronized_pool_resource>;
+}
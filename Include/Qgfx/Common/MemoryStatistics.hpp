@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../Platform/Atomics.hpp"
+
+namespace Qgfx
+{
+    /// Subsystems that host allocations are attributed to, see QGFX_MEMORY_TAG().
+    enum class MemoryTag : uint8_t
+    {
+        eGeneral = 0,
+        eDevice,
+        eQueue,
+        eRegistry,
+        eSwapChain,
+        eCount
+    };
+
+    const char* GetMemoryTagName(MemoryTag Tag);
+
+    struct MemoryCounters
+    {
+        Int64 LiveBytes = 0;
+        Int64 LiveAllocations = 0;
+        Int64 PeakBytes = 0;
+        Int64 TotalAllocations = 0;
+    };
+
+    struct MemoryStatisticsSnapshot
+    {
+        static constexpr uint32_t NumSizeBuckets = 32;
+
+        MemoryCounters Total;
+        MemoryCounters Tags[static_cast<size_t>(MemoryTag::eCount)];
+
+        /// Number of allocations made with a size in [2^i, 2^(i+1)). The last bucket also counts all larger sizes.
+        Int64 SizeHistogram[NumSizeBuckets] = {};
+    };
+
+    /// Thread safe allocation counters that allocators update when QGFX_MEMORY_STATISTICS is enabled.
+    class MemoryStatistics
+    {
+    public:
+        void RecordAllocation(size_t Size, MemoryTag Tag);
+        void RecordFree(size_t Size, MemoryTag Tag);
+
+        MemoryStatisticsSnapshot GetSnapshot();
+
+    private:
+        struct Counters
+        {
+            AtomicInt64 LiveBytes{ 0 };
+            AtomicInt64 LiveAllocations{ 0 };
+            AtomicInt64 PeakBytes{ 0 };
+            AtomicInt64 TotalAllocations{ 0 };
+        };
+
+        static void RecordAllocation(Counters& Counters, Int64 Size);
+        static void RecordFree(Counters& Counters, Int64 Size);
+        static void ReadCounters(Counters& Counters, MemoryCounters& Result);
+
+        Counters    m_Total;
+        Counters    m_Tags[static_cast<size_t>(MemoryTag::eCount)];
+        AtomicInt64 m_SizeHistogram[MemoryStatisticsSnapshot::NumSizeBuckets] = {};
+    };
+
+    /// Attributes the allocations made by the current thread to Tag until the scope is left.
+    class MemoryTagScope
+    {
+    public:
+        explicit MemoryTagScope(MemoryTag Tag);
+        ~MemoryTagScope();
+
+        static MemoryTag GetCurrentTag();
+
+    private:
+        MemoryTagScope(const MemoryTagScope&) = delete;
+        MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+        const MemoryTag m_PrevTag;
+    };
+}
+
+#if QGFX_MEMORY_STATISTICS
+
+#define QGFX_MEMORY_TAG_CONCAT_IMPL(A, B) A##B
+#define QGFX_MEMORY_TAG_CONCAT(A, B)      QGFX_MEMORY_TAG_CONCAT_IMPL(A, B)
+
+#define QGFX_MEMORY_TAG(Tag) ::Qgfx::MemoryTagScope QGFX_MEMORY_TAG_CONCAT(QgfxMemoryTagScope, __LINE__){ Tag }
+
+#else
+
+#define QGFX_MEMORY_TAG(Tag)
+
+#endif
@@ -1,34 +1,90 @@
 #pragma once
 
-#include "MemoryAllocator.hpp"
-
 #include <cstdint>
+#include <memory>
+
+#include "FixedBlockMemoryAllocator.hpp"
+#include "MemoryAllocator.hpp"
 
 namespace Qgfx
 {
-	class PoolAllocator final : public IMemoryAllocator
-	{
-	public:
+    /// General purpose allocator for small objects.
+
+    /// Every request is rounded up to one of a fixed set of size classes, and each size class is served
+    /// by its own FixedBlockMemoryAllocator. Allocation and deallocation therefore take constant time,
+    /// and objects of similar size end up next to each other in memory. Requests larger than
+    /// MaxSmallAllocationSize go to the raw allocator.
+    ///
+    /// Size classes are 8 bytes apart up to 64 bytes, followed by four classes per power of two
+    /// (80, 96, 112, 128, 160, 192, ...), so at most 25% of a block is wasted. Blocks are aligned
+    /// like FixedBlockMemoryAllocator blocks, which lets an aligned request be served by the
+    /// smallest size class that is a multiple of the alignment.
+    class PoolAllocator final : public IMemoryAllocator
+    {
+    public:
+        static constexpr size_t DefaultPageSize = 16384;
+        static constexpr size_t MaxSmallAllocationSize = 2048;
+
+        /// \param [in] RawMemoryAllocator - allocator used for memory pages and large allocations.
+        /// \param [in] PageSize - size of the memory pages of all size classes. Must be a power of two
+        ///                        that holds at least one block of the largest size class.
+        PoolAllocator(IMemoryAllocator& RawMemoryAllocator = DefaultRawMemoryAllocator::GetAllocator(), size_t PageSize = DefaultPageSize);
+        ~PoolAllocator();
+
+        /// Allocates block of memory
+        virtual void* Allocate(size_t Size) override final;
+
+        /// Allocates block of memory. Alignment must be less than the page size.
+        virtual void* Allocate(size_t Size, size_t Alignment) override final;
+
+        /// Releases memory
+        virtual void Free(void* Ptr) override final;
+
+#if QGFX_MEMORY_STATISTICS
+        /// Counts allocations by their size class block size, or by the requested size for large allocations
+        virtual MemoryStatistics* GetStatistics() override final { return &m_Statistics; }
+#endif
+
+        /// Returns empty pages of all size classes to the raw allocator.
+
+        /// \return Number of bytes returned to the raw allocator.
+        size_t Trim();
+
+    private:
+        // clang-format off
+        PoolAllocator(const PoolAllocator&) = delete;
+        PoolAllocator(PoolAllocator&&) = delete;
+        PoolAllocator& operator = (const PoolAllocator&) = delete;
+        PoolAllocator& operator = (PoolAllocator&&) = delete;
+        // clang-format on
+
+        static constexpr size_t   SizeClassGranularity = 8;
+        static constexpr uint32_t NumSizeClasses = 28;
+
+        static size_t GetSizeClassBlockSize(uint32_t SizeClass);
 
-		PoolAllocator()
-		{
-		}
+        void* AllocateLarge(size_t Size, size_t Alignment);
+        void  FreeLarge(void* Ptr);
 
-		~PoolAllocator()
-		{
-		}
+        // A large allocation starts with this header at a m_PageSize-aligned address, so Free() finds it
+        // the same way it finds the page of a small block. pOwner is always null, which tells the two apart.
+        struct LargeAllocationHeader
+        {
+            FixedBlockMemoryAllocator* pOwner;
+            size_t                     Size;
+            MemoryTag                  Tag;
+        };
 
-		void* Allocate(size_t Size) override
-		{
-			return new uint8_t[Size];
-		}
+        IMemoryAllocator& m_RawMemoryAllocator;
+        const size_t      m_PageSize;
 
-		void Deallocate(void* Ptr, size_t Size) override
-		{
-			delete[] reinterpret_cast<uint8_t*>(Ptr);
-		}
+        std::unique_ptr<FixedBlockMemoryAllocator> m_SizeClassAllocators[NumSizeClasses];
 
-	private:
+        // Maps (Size + 7) / 8 to the smallest size class that fits Size
+        uint8_t m_SizeClassLookup[MaxSmallAllocationSize / SizeClassGranularity + 1];
 
-	};
-}
\ No newline at end of file
+#if QGFX_MEMORY_STATISTICS
+        MemoryStatistics m_Statistics;
+#endif
+    };
+}
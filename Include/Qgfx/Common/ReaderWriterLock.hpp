@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Align.hpp"
+#include "Error.hpp"
+
+#include "../Platform/Atomics.hpp"
+
+namespace Qgfx
+{
+    // Reader-writer spin lock for read-mostly structures.
+    //
+    // Readers only touch their own stripe of the reader count, so threads that read at the same time do not
+    // take a cache line from each other. Threads are assigned to stripes by GetCurrentThreadIndex(). Writers
+    // take priority: once a writer is waiting no new reader gets in, and the writer then waits for the readers
+    // inside to drain from every stripe. This makes the write side more expensive than a plain SpinLock, so the
+    // lock pays off where reads greatly outnumber writes.
+    class ReaderWriterLock
+    {
+    public:
+        /// Number of reader count stripes. A power of two.
+        static constexpr uint32_t NumStripes = 16;
+
+        ReaderWriterLock() noexcept;
+
+        void LockShared() noexcept;
+
+        bool TryLockShared() noexcept;
+
+        void UnlockShared() noexcept;
+
+        void Lock() noexcept;
+
+        bool TryLock() noexcept;
+
+        void Unlock() noexcept;
+
+    private:
+        // clang-format off
+        ReaderWriterLock(const ReaderWriterLock&) = delete;
+        ReaderWriterLock(ReaderWriterLock&&) = delete;
+        ReaderWriterLock& operator = (const ReaderWriterLock&) = delete;
+        ReaderWriterLock& operator = (ReaderWriterLock&&) = delete;
+        // clang-format on
+
+        struct alignas(CacheLineSize) Stripe
+        {
+            AtomicLong NumReaders;
+        };
+
+        AtomicLong& GetCurrentThreadStripe() noexcept;
+
+        void WaitForReaders() noexcept;
+
+        Stripe m_Stripes[NumStripes];
+
+        // Set while a writer holds the lock or waits for the readers to leave
+        alignas(CacheLineSize) AtomicLong m_WriterFlag;
+    };
+
+    /// Holds the shared side of a ReaderWriterLock for its lifetime
+    class ReadLock
+    {
+    public:
+        explicit ReadLock(ReaderWriterLock& Lock) noexcept :
+            m_Lock{ Lock }
+        {
+            m_Lock.LockShared();
+        }
+
+        ~ReadLock()
+        {
+            m_Lock.UnlockShared();
+        }
+
+        ReadLock(const ReadLock&) = delete;
+        ReadLock& operator=(const ReadLock&) = delete;
+
+    private:
+        ReaderWriterLock& m_Lock;
+    };
+
+    /// Holds the exclusive side of a ReaderWriterLock for its lifetime
+    class WriteLock
+    {
+    public:
+        explicit WriteLock(ReaderWriterLock& Lock) noexcept :
+            m_Lock{ Lock }
+        {
+            m_Lock.Lock();
+        }
+
+        ~WriteLock()
+        {
+            m_Lock.Unlock();
+        }
+
+        WriteLock(const WriteLock&) = delete;
+        WriteLock& operator=(const WriteLock&) = delete;
+
+    private:
+        ReaderWriterLock& m_Lock;
+    };
+}
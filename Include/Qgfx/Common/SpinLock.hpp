@@ -4,8 +4,16 @@
 
 #include "../Platform/Atomics.hpp"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(_M_ARM) || defined(_M_ARM64)
+#include <intrin.h>
+#endif
+
 namespace Qgfx
 {
+    class SpinLock;
+
     class SpinLockFlag
     {
     public:
@@ -15,6 +23,9 @@ namespace Qgfx
             Locked = 1
         };
 
+        /// Guard type that locks this flag, so code can be written against either lock flag
+        using LockType = SpinLock;
+
         SpinLockFlag(Numerics::Long InitFlag = static_cast<Numerics::Long>(SpinLockFlag::State::Unlocked)) noexcept
         {
             //m_Flag.store(InitFlag);
@@ -64,8 +75,9 @@ namespace Qgfx
 
         static bool UnsafeTryLock(SpinLockFlag& LockFlag) noexcept
         {
+            // Acquire, so that the critical section cannot start before the lock is taken
             return Atomics::CompareExchange(LockFlag.m_Flag, static_cast<Numerics::Long>(SpinLockFlag::State::Locked),
-                static_cast<Numerics::Long>(SpinLockFlag::State::Unlocked)) == SpinLockFlag::State::Unlocked;
+                static_cast<Numerics::Long>(SpinLockFlag::State::Unlocked), MemoryOrder::eAcquire) == SpinLockFlag::State::Unlocked;
         }
 
         bool TryLock(SpinLockFlag& LockFlag) noexcept
@@ -79,41 +91,63 @@ namespace Qgfx
                 return false;
         }
 
+        /// Number of pauses a waiting thread spins for before it yields its time slice
         static constexpr const int DefaultSpinCountToYield = 256;
 
+        /// Longest run of pauses between two looks at the flag
+        static constexpr const int MaxBackoffPauses = 64;
+
         static void UnsafeLock(SpinLockFlag& LockFlag, int SpinCountToYield = DefaultSpinCountToYield) noexcept
         {
+            // Test and test-and-set: only try to take the lock when it looks free. Waiting threads read the
+            // flag, so they share its cache line instead of taking it from each other on every spin.
+            int NumPauses = 1;
             int SpinCount = 0;
             while (!UnsafeTryLock(LockFlag))
             {
-                ++SpinCount;
-                if (SpinCount == SpinCountToYield)
+                do
                 {
-                    SpinCount = 0;
-                    YieldThread();
-                }
+                    // Back off exponentially, so that a crowd of waiters does not rush the flag at once when it is freed
+                    for (int i = 0; i < NumPauses; ++i)
+                        Pause();
+
+                    SpinCount += NumPauses;
+                    if (NumPauses < MaxBackoffPauses)
+                        NumPauses *= 2;
+
+                    if (SpinCount >= SpinCountToYield)
+                    {
+                        SpinCount = 0;
+                        YieldThread();
+                    }
+                } while (Atomics::Load(LockFlag.m_Flag, MemoryOrder::eRelaxed) != SpinLockFlag::State::Unlocked);
             }
         }
 
         void Lock(SpinLockFlag& LockFlag, int SpinCountToYield = DefaultSpinCountToYield) noexcept
         {
             QGFX_VERIFY(m_pLockFlag == nullptr, "Object already locked");
-            // Wait for the flag to become unlocked and lock it
-            int SpinCount = 0;
-            while (!TryLock(LockFlag))
-            {
-                ++SpinCount;
-                if (SpinCount == SpinCountToYield)
-                {
-                    SpinCount = 0;
-                    YieldThread();
-                }
-            }
+            UnsafeLock(LockFlag, SpinCountToYield);
+            m_pLockFlag = &LockFlag;
+        }
+
+        /// Tells the CPU that the thread is spinning, which saves power and frees execution resources for the
+        /// other hardware thread on the core
+        static void Pause() noexcept
+        {
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+            _mm_pause();
+#elif defined(_M_ARM) || defined(_M_ARM64)
+            __yield();
+#elif defined(__arm__) || defined(__aarch64__)
+            __asm__ __volatile__("yield");
+#endif
         }
 
         static void UnsafeUnlock(SpinLockFlag& LockFlag) noexcept
         {
-            LockFlag.m_Flag = SpinLockFlag::State::Unlocked;
+            // Release, so that the critical section cannot leak past the unlock
+            Atomics::Store(LockFlag.m_Flag, static_cast<Numerics::Long>(SpinLockFlag::State::Unlocked), MemoryOrder::eRelease);
         }
 
         void Unlock() noexcept
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Qgfx
+{
+    /// Returns a small integer that identifies the calling thread.
+
+    /// Every thread gets the next free index the first time it calls the function, and keeps it for its
+    /// lifetime. Indices are handed out in order, so masking one with a power of two minus one spreads
+    /// threads evenly over per-thread slots, such as allocator caches or lock stripes.
+    uint32_t GetCurrentThreadIndex();
+}
@@ -37,6 +37,13 @@ namespace Qgfx
 		*/
 		void GetQueue(IQueue** ppQueue);
 
+		RefPtr<IQueue> GetQueue();
+
+		/**
+		 * @brief Retreives the queue without incrementing its references. The command buffer keeps the queue alive.
+		*/
+		BorrowedPtr<IQueue> BorrowQueue() const { return BorrowedPtr<IQueue>{ m_pQueue }; }
+
 		inline CommandBufferState GetState() { return m_State; }
 
 	protected:
@@ -110,6 +117,10 @@ namespace Qgfx
 
 		void GetDevice(IDevice** ppDevice);
 
+		RefPtr<IDevice> GetDevice();
+
+		BorrowedPtr<IDevice> BorrowDevice() const { return BorrowedPtr<IDevice>{ m_pDevice }; }
+
 	protected:
 		
 		IQueue(IDevice* pDevice);
@@ -286,8 +297,16 @@ namespace Qgfx
 
 		void GetQueue(IQueue** ppQueue);
 
+		RefPtr<IQueue> GetQueue();
+
+		BorrowedPtr<IQueue> BorrowQueue() const { return BorrowedPtr<IQueue>{ m_pQueue }; }
+
 		void GetRenderer(IRenderer** ppRenderer);
 
+		RefPtr<IRenderer> GetRenderer();
+
+		BorrowedPtr<IRenderer> BorrowRenderer() const { return BorrowedPtr<IRenderer>{ m_pRenderer }; }
+
 	protected:
 
 		ISwapChain(IRenderer* pRenderer, IQueue* pQueue, const SwapChainDesc& Descriptor);
@@ -360,8 +379,16 @@ namespace Qgfx
 
 		void GetRenderer(IRenderer** ppRenderer);
 
+		RefPtr<IRenderer> GetRenderer();
+
+		BorrowedPtr<IRenderer> BorrowRenderer() const { return BorrowedPtr<IRenderer>{ m_pRenderer }; }
+
 		void GetAdapter(IAdapter** ppAdapter);
 
+		RefPtr<IAdapter> GetAdapter();
+
+		BorrowedPtr<IAdapter> BorrowAdapter() const { return BorrowedPtr<IAdapter>{ m_pAdapter }; }
+
 		IMemoryAllocator& GetRawMemAllocator();
 
 	protected:
@@ -389,6 +416,10 @@ namespace Qgfx
 
 		void GetRenderer(IRenderer** ppRenderer);
 
+		RefPtr<IRenderer> GetRenderer();
+
+		BorrowedPtr<IRenderer> BorrowRenderer() const { return BorrowedPtr<IRenderer>{ m_pRenderer }; }
+
 	protected:
 
 		IAdapter(IRenderer* pRenderer);
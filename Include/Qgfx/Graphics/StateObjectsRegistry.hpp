@@ -1,30 +1,57 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
 #include <utility>
 
-#include "IObject.hpp"
-
+#include "../Common/Align.hpp"
+#include "../Common/EpochManager.hpp"
 #include "../Common/Error.hpp"
+#include "../Common/FlatHashMap.hpp"
+#include "../Common/HybridLock.hpp"
+#include "../Common/IRefCountedObject.hpp"
+#include "../Common/LockProfiler.hpp"
 #include "../Common/MemoryAllocator.hpp"
-#include "../Common/RefPtr.hpp"
-#include "../Common/SpinLock.hpp"
-#include "../Common/STDAllocator.hpp"
 
 namespace Qgfx
 {
     /// Template class implementing state object registry
-    template <typename ResourceDescType, int DeletedObjectsToPurge = 32>
+
+    /// The registry is split into NumShards shards picked by the hash of the description. Every shard has
+    /// its own writer lock, table and count of deleted objects, so threads creating different objects rarely
+    /// meet on the same lock.
+    ///
+    /// Find() takes no lock. Every shard keeps its objects in a Swiss table of pointers to immutable entries:
+    /// a lookup matches the 7-bit tags in a group of control bytes (see HashControlGroup) and only loads the
+    /// slots whose tag matches, then compares the full hash cached in the entry before the description.
+    /// Writers never change an entry that has been published: they replace it, or mark its slot deleted,
+    /// and retire the old entry. A table that grows is published by pointer and the old one is retired
+    /// the same way. Retired memory is freed once the shard's EpochManager says that no lookup can still see it.
+    /// Add() and Purge() are serialized by the shard's writer lock.
+    ///
+    /// Expired references are purged a few slots at a time. Add() and ReportDeletedObject() check the next
+    /// NumSlotsPerPurgeStep slots of the shard while it has deleted objects outstanding, and growing a table
+    /// leaves the expired references behind, so no call other than an explicit Purge() walks a whole shard.
+    template <typename ResourceDescType, uint32_t NumSlotsPerPurgeStep = 32, uint32_t NumShards = 8>
     class StateObjectsRegistry
     {
     public:
-
-        using HashMapElem = std::pair<const ResourceDescType, WeakPtr<IObject>>;
+        static_assert(NumShards > 0 && (NumShards & (NumShards - 1)) == 0, "NumShards must be a power of two");
+        static_assert(NumShards <= 256, "The shard index is taken from 8 bits of the hash above the ones that pick the group");
 
         StateObjectsRegistry(IMemoryAllocator& RawAllocator) :
-            m_NumDeletedObjects{ 0 },
-            m_DescToObjHashMap(STDAllocatorRawMem<HashMapElem>(RawAllocator)),
-        {}
+            m_RawAllocator{ RawAllocator }
+        {
+            m_pShards = reinterpret_cast<Shard*>(m_RawAllocator.Allocate(sizeof(Shard) * NumShards, alignof(Shard)));
+            for (uint32_t i = 0; i < NumShards; ++i)
+            {
+                new (&m_pShards[i]) Shard;
+                m_pShards[i].pTable.store(CreateTable(MinTableCapacity), std::memory_order_relaxed);
+            }
+        }
 
         ~StateObjectsRegistry()
         {
@@ -34,7 +61,17 @@ namespace Qgfx
             // may only be expired references in the registry. After we
             // purge it, the registry must be empty.
             Purge();
-            QGFX_VERIFY(m_DescToObjHashMap.empty(), "DescToObjHashMap is not empty");
+            for (uint32_t i = 0; i < NumShards; ++i)
+            {
+                Shard& DestroyedShard = m_pShards[i];
+                QGFX_VERIFY(DestroyedShard.NumLiveEntries == 0, "The registry is not empty");
+
+                // There are no readers left, so everything can be freed regardless of the epoch
+                ReclaimRetired(DestroyedShard, true);
+                DestroyTable(DestroyedShard.pTable.load(std::memory_order_relaxed));
+                DestroyedShard.~Shard();
+            }
+            m_RawAllocator.Free(m_pShards);
         }
 
         /// Adds a new object to the registry
@@ -43,125 +80,500 @@ namespace Qgfx
         /// \param [in] pObject - pointer to the object.
         ///
         /// Besides adding a new object, the function also checks the number of
-        /// outstanding deleted objects and calls Purge() if the number has reached
-        /// the threshold value DeletedObjectsToPurge. Creating a state object is
-        /// assumed to be an expensive operation and should be performed during
-        /// the initialization. Occasional purge operations should not add significant
-        /// cost to it.
-        void Add(const ResourceDescType& ObjectDesc, IObject* pObject)
-        {
-            SpinLock Lock(m_LockFlag);
-
-            // If the number of outstanding deleted objects reached the threshold value,
-            // purge the registry. Since we have exclusive access now, it is safe
-            // to do.
-            if (m_NumDeletedObjects >= DeletedObjectsToPurge)
-            {
-                Purge();
-                m_NumDeletedObjects = 0;
-            }
-
-            // Try to construct the new element in place
-            auto Elems = m_DescToObjHashMap.emplace(std::make_pair(ObjectDesc, WeakPtr<IObject>(pObject)));
-            // It is theorertically possible that the same object can be found
-            // in the registry. This might happen if two threads try to create
-            // the same object at the same time. They both will not find the
-            // object and then will create and try to add it.
-            //
-            // If the object already exists, we replace the existing reference.
-            // This is safer as there might be scenarios where existing reference
-            // might be expired. For instance, two threads try to create the same
-            // object which is not in the registry. The first thread creates
-            // the object, adds it to the registry and then releases it. After that
-            // the second thread creates the same object and tries to add it to
-            // the registry. It will find an existing expired reference to the
-            // object.
-            if (!Elems.second)
-            {
-                QGFX_VERIFY(Elems.first->first == ObjectDesc, "Incorrect object description");
-                QGFX_LOG_WARNING_MESSAGE("Object named '", Elems.first->first.Name,
-                    "' with the same description already exists in the registry."
-                    "Replacing with the new object named '",
-                    ObjectDesc.Name ? ObjectDesc.Name : "", "'.");
-                Elems.first->second = pObject;
+        /// outstanding deleted objects in the shard and, if there are any, checks the
+        /// next NumSlotsPerPurgeStep slots of the shard for expired references.
+        void Add(const ResourceDescType& ObjectDesc, IRefCountedObject* pObject)
+        {
+            QGFX_MEMORY_TAG(MemoryTag::eRegistry);
+
+            const uint64_t Hash = ComputeHash(ObjectDesc);
+            Shard&         DescShard = GetShard(Hash);
+
+            Entry* pNewEntry = reinterpret_cast<Entry*>(m_RawAllocator.Allocate(sizeof(Entry), alignof(Entry)));
+            new (pNewEntry) Entry(Hash, ObjectDesc, pObject);
+
+            QGFX_LOCK_GUARD(Lock, DescShard.WriterLockFlag, "StateObjectsRegistry::Shard::WriterLockFlag");
+
+            // If there are outstanding deleted objects, take a purge step. Since we have
+            // exclusive access now, it is safe to do.
+            if (Atomics::Load(DescShard.NumDeletedObjects, MemoryOrder::eRelaxed) > 0)
+                PurgeStep(DescShard);
+
+            Table* pTable = DescShard.pTable.load(std::memory_order_relaxed);
+            // At most 7/8 of the slots are used, so that every probe sequence ends at a group with an empty slot
+            if ((DescShard.NumUsedSlots + 1) * 8 > pTable->Capacity * 7)
+                pTable = Rehash(DescShard);
+
+            const uint8_t  H2 = HashControlGroup::GetH2(Hash);
+            const uint32_t GroupMask = pTable->GetNumGroups() - 1;
+            uint32_t       FreeSlot = InvalidSlot;
+            uint32_t       Group = GetFirstGroup(Hash) & GroupMask;
+            for (uint32_t Step = 1;; ++Step)
+            {
+                const HashControlGroup Control = pTable->LoadGroup(Group, std::memory_order_relaxed);
+                for (uint32_t Mask = Control.Match(H2); Mask != 0; Mask &= Mask - 1)
+                {
+                    const uint32_t       i = Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(Mask);
+                    std::atomic<Entry*>& Slot = pTable->GetSlots()[i];
+                    Entry*               pEntry = Slot.load(std::memory_order_relaxed);
+
+                    // It is theorertically possible that the same object can be found
+                    // in the registry. This might happen if two threads try to create
+                    // the same object at the same time. They both will not find the
+                    // object and then will create and try to add it.
+                    //
+                    // If the object already exists, we replace the existing reference.
+                    // This is safer as there might be scenarios where existing reference
+                    // might be expired. For instance, two threads try to create the same
+                    // object which is not in the registry. The first thread creates
+                    // the object, adds it to the registry and then releases it. After that
+                    // the second thread creates the same object and tries to add it to
+                    // the registry. It will find an existing expired reference to the
+                    // object.
+                    if (pEntry->Hash == Hash && pEntry->Desc == ObjectDesc)
+                    {
+                        // Find() leaves expired references in place, so replacing one of those is the common case
+                        if (pEntry->pObject.IsValid())
+                            QGFX_LOG_WARNING_MESSAGE("Object named '", pEntry->Desc.Name,
+                                "' with the same description already exists in the registry."
+                                "Replacing with the new object named '",
+                                ObjectDesc.Name ? ObjectDesc.Name : "", "'.");
+
+                        // Release, so that a lookup that loads the entry also sees its contents. The tag stays the same.
+                        Slot.store(pNewEntry, std::memory_order_release);
+                        RetireEntry(DescShard, pEntry);
+                        ReclaimRetired(DescShard, false);
+                        return;
+                    }
+                }
+
+                if (FreeSlot == InvalidSlot)
+                {
+                    const uint32_t FreeMask = Control.MatchEmptyOrDeleted();
+                    if (FreeMask != 0)
+                        FreeSlot = Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(FreeMask);
+                }
+
+                // The object cannot be further on than the first group with an empty slot
+                if (Control.MatchEmpty() != 0)
+                    break;
+
+                Group = (Group + Step) & GroupMask;
             }
+
+            if (pTable->GetControl(FreeSlot) == HashControlGroup::Empty)
+                ++DescShard.NumUsedSlots;
+
+            // The entry is stored before the tag, so a lookup that matches the tag finds it
+            pTable->GetSlots()[FreeSlot].store(pNewEntry, std::memory_order_release);
+            pTable->SetControl(FreeSlot, H2);
+            ++DescShard.NumLiveEntries;
+            ReclaimRetired(DescShard, false);
         }
 
         /// Finds the object in the registry
-        void Find(const ResourceDescType& Desc, IObject** ppObject)
+        void Find(const ResourceDescType& Desc, IRefCountedObject** ppObject)
         {
             QGFX_VERIFY(*ppObject == nullptr, "Overwriting reference to existing object may cause memory leaks");
             *ppObject = nullptr;
 
-            SpinLock Lock(m_LockFlag);
+            const uint64_t Hash = ComputeHash(Desc);
+            Shard&         DescShard = GetShard(Hash);
+
+            // Keeps the entries and the table this lookup loads from being freed under it
+            EpochGuard Guard{ DescShard.Epochs };
 
-            auto It = m_DescToObjHashMap.find(Desc);
-            if (It != m_DescToObjHashMap.end())
+            // Acquire, so that the slots of a table published by Rehash() are seen initialized
+            Table*         pTable = DescShard.pTable.load(std::memory_order_acquire);
+            const uint8_t  H2 = HashControlGroup::GetH2(Hash);
+            const uint32_t GroupMask = pTable->GetNumGroups() - 1;
+            uint32_t       Group = GetFirstGroup(Hash) & GroupMask;
+            for (uint32_t Step = 1;; ++Step)
             {
-                // Try to obtain strong reference to the object.
-                // This is an atomic operation and we either get
-                // a new strong reference or object has been destroyed
-                // and we get null.
-                auto pObject = It->second.Lock();
-                if (pObject)
+                // Acquire, so that the slot of a matching tag holds the entry stored before the tag
+                const HashControlGroup Control = pTable->LoadGroup(Group, std::memory_order_acquire);
+                for (uint32_t Mask = Control.Match(H2); Mask != 0; Mask &= Mask - 1)
                 {
-                    *ppObject = pObject.Detach();
-                    //LOG_INFO_MESSAGE( "Equivalent of the requested state object named \"", Desc.Name ? Desc.Name : "", "\" found in the ", m_RegistryName, " registry. Reusing existing object.");
-                }
-                else
-                {
-                    // Expired object found: remove it from the map
-                    m_DescToObjHashMap.erase(It);
-                    Atomics::AtomicDecrement(m_NumDeletedObjects);
+                    // Null if the entry has just been purged
+                    Entry* pEntry = pTable->GetSlots()[Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(Mask)].load(std::memory_order_acquire);
+                    if (pEntry == nullptr || pEntry->Hash != Hash || !(pEntry->Desc == Desc))
+                        continue;
+
+                    // Try to obtain strong reference to the object.
+                    // This is an atomic operation and we either get
+                    // a new strong reference or object has been destroyed
+                    // and we get null. It does not take any lock.
+                    // An expired entry is left for Purge(), and Add()
+                    // replaces it if an equivalent object is created
+                    // in the meantime.
+                    auto pObject = pEntry->pObject.Lock();
+                    if (pObject)
+                    {
+                        *ppObject = pObject.Detach();
+                        //LOG_INFO_MESSAGE( "Equivalent of the requested state object named \"", Desc.Name ? Desc.Name : "", "\" found in the ", m_RegistryName, " registry. Reusing existing object.");
+                    }
+                    return;
                 }
+
+                if (Control.MatchEmpty() != 0)
+                    return;
+
+                Group = (Group + Step) & GroupMask;
             }
         }
 
-        /// Purges outstanding deleted objects from the registry
+        /// Purges outstanding deleted objects from all shards of the registry
         void Purge()
         {
             uint32_t NumPurgedObjects = 0;
-            auto It = m_DescToObjHashMap.begin();
-            while (It != m_DescToObjHashMap.end())
-            {
-                auto NextIt = It;
-                ++NextIt;
-                // Note that IsValid() is not a thread-safe function in the sense that it
-                // can give false positive results. The only thread-safe way to check if the
-                // object is alive is to lock the weak pointer, but that requires thread
-                // synchronization. We will immediately unlock the pointer anyway, so we
-                // want to detect 100% expired pointers. IsValid() does provide that information
-                // because once a weak pointer becomes invalid, it will be invalid
-                // until it is destroyed. It is not a problem if we miss an expired weak
-                // pointer as it will definitiely be removed next time.
-                if (!It->second.IsValid())
+            for (uint32_t i = 0; i < NumShards; ++i)
+            {
+                QGFX_LOCK_GUARD(Lock, m_pShards[i].WriterLockFlag, "StateObjectsRegistry::Shard::WriterLockFlag");
+                NumPurgedObjects += PurgeShard(m_pShards[i]);
+                ReclaimRetired(m_pShards[i], false);
+            }
+            QGFX_LOG_INFO_MESSAGE("Purged ", NumPurgedObjects, " deleted objects from registry");
+        }
+
+        /// Increments the number of outstanding deleted objects in the shard of Desc
+        /// and takes a purge step if no other thread is writing to the shard. Otherwise
+        /// the step is left to the next Add() to the shard.
+        void ReportDeletedObject(const ResourceDescType& Desc)
+        {
+            Shard& DescShard = GetShard(ComputeHash(Desc));
+            Atomics::Increment(DescShard.NumDeletedObjects, MemoryOrder::eRelaxed);
+
+            // Never waits, as objects are deleted on whatever thread releases them last
+            HybridLock Lock;
+            if (Lock.TryLock(DescShard.WriterLockFlag))
+            {
+                PurgeStep(DescShard);
+                ReclaimRetired(DescShard, false);
+            }
+        }
+
+    private:
+        static constexpr uint32_t MinTableCapacity = HashControlGroup::Width;
+
+        static constexpr uint32_t InvalidSlot = ~0u;
+
+        /// Registered object. Never modified once a table slot points to it.
+        struct Entry
+        {
+            Entry(uint64_t InHash, const ResourceDescType& InDesc, IRefCountedObject* pInObject) :
+                Hash{ InHash },
+                Desc(InDesc),
+                pObject(pInObject)
+            {}
+
+            const uint64_t             Hash;
+            const ResourceDescType     Desc;
+            WeakPtr<IRefCountedObject> pObject;
+
+            /// Next entry in the shard's list of retired entries
+            Entry* pNextRetired = nullptr;
+            Int64  RetireEpoch = 0;
+        };
+
+        /// Header of a table, followed by the control bytes of its Capacity slots, in words of
+        /// eight as HashControlGroup takes them, and then by the slots
+        struct Table
+        {
+            /// A multiple of the group width and a power of two
+            uint32_t Capacity = 0;
+
+            /// Next table in the shard's list of retired tables
+            Table* pNextRetired = nullptr;
+            Int64  RetireEpoch = 0;
+
+            uint32_t GetNumGroups() const
+            {
+                return Capacity / HashControlGroup::Width;
+            }
+
+            std::atomic<uint64_t>* GetControlWords()
+            {
+                return reinterpret_cast<std::atomic<uint64_t>*>(reinterpret_cast<uint8_t*>(this) + GetControlWordsOffset());
+            }
+
+            std::atomic<Entry*>* GetSlots()
+            {
+                return reinterpret_cast<std::atomic<Entry*>*>(reinterpret_cast<uint8_t*>(this) + GetSlotsOffset(Capacity));
+            }
+
+            HashControlGroup LoadGroup(uint32_t Group, std::memory_order Order)
+            {
+                std::atomic<uint64_t>* pWords = GetControlWords() + Group * 2;
+                return HashControlGroup{ pWords[0].load(Order), pWords[1].load(Order) };
+            }
+
+            /// Must be called while the shard's writer lock is held
+            uint8_t GetControl(uint32_t i)
+            {
+                return HashControlGroup::GetControlByte(GetControlWords()[i / 8].load(std::memory_order_relaxed), i % 8);
+            }
+
+            /// Must be called while the shard's writer lock is held. Release, so that a lookup that sees
+            /// the new tag also sees the slot stored before it.
+            void SetControl(uint32_t i, uint8_t Control)
+            {
+                std::atomic<uint64_t>& Word = GetControlWords()[i / 8];
+                Word.store(HashControlGroup::SetControlByte(Word.load(std::memory_order_relaxed), i % 8, Control), std::memory_order_release);
+            }
+
+            static size_t GetControlWordsOffset()
+            {
+                return AlignUp(sizeof(Table), alignof(std::atomic<uint64_t>));
+            }
+
+            static size_t GetSlotsOffset(uint32_t Capacity)
+            {
+                return AlignUp(GetControlWordsOffset() + sizeof(std::atomic<uint64_t>) * (Capacity / 8), alignof(std::atomic<Entry*>));
+            }
+        };
+
+        // Shards are cache line aligned, so that neighbouring shards do not share a line
+        struct alignas(CacheLineSize) Shard
+        {
+            EpochManager Epochs;
+
+            /// Loaded by every lookup, so it is kept away from the data that writers change
+            alignas(CacheLineSize) std::atomic<Table*> pTable{ nullptr };
+
+            /// Serializes Add() and Purge(). Everything below is only accessed while it is held,
+            /// except NumDeletedObjects, which is atomic.
+            alignas(CacheLineSize) HybridLockFlag WriterLockFlag;
+
+            /// Nmber of outstanding deleted objects in this shard that have not been purged
+            AtomicLong NumDeletedObjects{ 0 };
+
+            uint32_t NumLiveEntries = 0;
+
+            /// Number of slots whose control byte is not empty, including the deleted ones
+            uint32_t NumUsedSlots = 0;
+
+            /// Where the next purge step starts. Runs freely and is masked by the table capacity.
+            uint32_t PurgeCursor = 0;
+
+            Entry* pRetiredEntries = nullptr;
+            Table* pRetiredTables = nullptr;
+        };
+
+        static uint64_t ComputeHash(const ResourceDescType& Desc)
+        {
+            // Mixed, so that the bits the shard, the group and the tag are taken from are well distributed
+            return HashControlGroup::MixHash(std::hash<ResourceDescType>{}(Desc));
+        }
+
+        Shard& GetShard(uint64_t Hash)
+        {
+            return m_pShards[static_cast<uint32_t>(Hash >> 32) & (NumShards - 1)];
+        }
+
+        static uint32_t GetFirstGroup(uint64_t Hash)
+        {
+            // Below the bits that pick the shard, which are the same for all entries of a table
+            return static_cast<uint32_t>(HashControlGroup::GetH1(Hash));
+        }
+
+        Table* CreateTable(uint32_t Capacity)
+        {
+            Table* pTable = reinterpret_cast<Table*>(m_RawAllocator.Allocate(Table::GetSlotsOffset(Capacity) + sizeof(std::atomic<Entry*>) * Capacity, alignof(Table)));
+            new (pTable) Table;
+            pTable->Capacity = Capacity;
+
+            std::atomic<uint64_t>* pControlWords = pTable->GetControlWords();
+            for (uint32_t i = 0; i < Capacity / 8; ++i)
+                new (&pControlWords[i]) std::atomic<uint64_t>{ 0x8080808080808080ull };
+
+            std::atomic<Entry*>* pSlots = pTable->GetSlots();
+            for (uint32_t i = 0; i < Capacity; ++i)
+                new (&pSlots[i]) std::atomic<Entry*>{ nullptr };
+            return pTable;
+        }
+
+        /// Frees a table without touching the entries its slots point to
+        void DestroyTable(Table* pTable)
+        {
+            pTable->~Table();
+            m_RawAllocator.Free(pTable);
+        }
+
+        void DestroyEntry(Entry* pEntry)
+        {
+            pEntry->~Entry();
+            m_RawAllocator.Free(pEntry);
+        }
+
+        static void RetireEntry(Shard& RetiringShard, Entry* pEntry)
+        {
+            pEntry->RetireEpoch = RetiringShard.Epochs.GetEpoch();
+            pEntry->pNextRetired = RetiringShard.pRetiredEntries;
+            RetiringShard.pRetiredEntries = pEntry;
+        }
+
+        /// Moves the live entries to a new table sized for them, publishes it and retires the old one.
+        /// Must be called while the shard's writer lock is held.
+        Table* Rehash(Shard& RehashedShard)
+        {
+            Table* pOldTable = RehashedShard.pTable.load(std::memory_order_relaxed);
+
+            // A quarter full after the move, so the table does not grow again right away. If most used slots
+            // belong to deleted entries, this may be the same size, which just drops the deleted slots.
+            uint32_t Capacity = MinTableCapacity;
+            while (Capacity < (RehashedShard.NumLiveEntries + 1) * 4)
+                Capacity *= 2;
+
+            Table*         pNewTable = CreateTable(Capacity);
+            const uint32_t GroupMask = pNewTable->GetNumGroups() - 1;
+            for (uint32_t OldSlot = 0; OldSlot < pOldTable->Capacity; ++OldSlot)
+            {
+                if (!HashControlGroup::IsFull(pOldTable->GetControl(OldSlot)))
+                    continue;
+
+                Entry* pEntry = pOldTable->GetSlots()[OldSlot].load(std::memory_order_relaxed);
+
+                // Every entry is visited anyway, so expired references are dropped on the way
+                if (!pEntry->pObject.IsValid())
                 {
-                    m_DescToObjHashMap.erase(It);
-                    ++NumPurgedObjects;
+                    RetireEntry(RehashedShard, pEntry);
+                    --RehashedShard.NumLiveEntries;
+                    continue;
                 }
 
-                It = NextIt;
+                uint32_t Group = GetFirstGroup(pEntry->Hash) & GroupMask;
+                uint32_t FreeMask = pNewTable->LoadGroup(Group, std::memory_order_relaxed).MatchEmpty();
+                for (uint32_t Step = 1; FreeMask == 0; ++Step)
+                {
+                    Group = (Group + Step) & GroupMask;
+                    FreeMask = pNewTable->LoadGroup(Group, std::memory_order_relaxed).MatchEmpty();
+                }
+
+                // The table is not visible to lookups yet, publishing it below releases these stores
+                const uint32_t i = Group * HashControlGroup::Width + HashControlGroup::GetLowestMatch(FreeMask);
+                pNewTable->GetSlots()[i].store(pEntry, std::memory_order_relaxed);
+                pNewTable->SetControl(i, HashControlGroup::GetH2(pEntry->Hash));
             }
-            QGFX_LOG_INFO_MESSAGE("Purged ", NumPurgedObjects, " deleted objects from registry");
+            RehashedShard.NumUsedSlots = RehashedShard.NumLiveEntries;
+
+            RehashedShard.pTable.store(pNewTable, std::memory_order_release);
+
+            // Lookups that started before the store may still probe the old table
+            pOldTable->RetireEpoch = RehashedShard.Epochs.GetEpoch();
+            pOldTable->pNextRetired = RehashedShard.pRetiredTables;
+            RehashedShard.pRetiredTables = pOldTable;
+
+            return pNewTable;
         }
 
-        /// Increments the number of outstanding deleted objects.
-        /// When this number reaches DeletedObjectsToPurge, Purge() will
-        /// be called.
-        void ReportDeletedObject()
+        /// Removes the reference in slot i of the shard's table if it has expired, returns whether it did.
+        /// Must be called while the shard's writer lock is held.
+        static bool PurgeSlot(Shard& PurgedShard, Table* pTable, uint32_t i)
         {
-            Atomics::AtomicIncrement(m_NumDeletedObjects);
+            if (!HashControlGroup::IsFull(pTable->GetControl(i)))
+                return false;
+
+            Entry* pEntry = pTable->GetSlots()[i].load(std::memory_order_relaxed);
+
+            // Note that IsValid() is not a thread-safe function in the sense that it
+            // can give false positive results. The only thread-safe way to check if the
+            // object is alive is to lock the weak pointer, but that requires thread
+            // synchronization. We will immediately unlock the pointer anyway, so we
+            // want to detect 100% expired pointers. IsValid() does provide that information
+            // because once a weak pointer becomes invalid, it will be invalid
+            // until it is destroyed. It is not a problem if we miss an expired weak
+            // pointer as it will definitiely be removed next time.
+            if (pEntry->pObject.IsValid())
+                return false;
+
+            // If the group still has an empty slot, no probe sequence has ever run through it, and the slot can
+            // become empty again. Otherwise it must stay used, so that the sequences running through it continue.
+            if (pTable->LoadGroup(i / HashControlGroup::Width, std::memory_order_relaxed).MatchEmpty() != 0)
+            {
+                pTable->SetControl(i, HashControlGroup::Empty);
+                --PurgedShard.NumUsedSlots;
+            }
+            else
+                pTable->SetControl(i, HashControlGroup::Deleted);
+
+            // A lookup that matched the old tag may still load the slot, and finds nothing
+            pTable->GetSlots()[i].store(nullptr, std::memory_order_relaxed);
+            RetireEntry(PurgedShard, pEntry);
+            --PurgedShard.NumLiveEntries;
+            return true;
         }
 
-    private:
-        /// Lock flag to protect the m_DescToObjHashMap
-        SpinLockFlag m_LockFlag;
+        /// Checks the next NumSlotsPerPurgeStep slots of the shard's table for expired references, starting
+        /// where the previous step stopped. Must be called while the shard's writer lock is held.
+        static void PurgeStep(Shard& PurgedShard)
+        {
+            Table*         pTable = PurgedShard.pTable.load(std::memory_order_relaxed);
+            const uint32_t NumSlots = std::min(NumSlotsPerPurgeStep, pTable->Capacity);
+
+            Long NumPurgedObjects = 0;
+            for (uint32_t i = 0; i < NumSlots; ++i)
+            {
+                if (PurgeSlot(PurgedShard, pTable, PurgedShard.PurgeCursor++ & (pTable->Capacity - 1)))
+                    ++NumPurgedObjects;
+            }
+
+            // The count is only a hint of whether steps are worth taking. It may count objects whose
+            // references were replaced rather than purged, and then stays above zero, which costs
+            // an occasional step that finds nothing.
+            if (NumPurgedObjects != 0 && Atomics::Add(PurgedShard.NumDeletedObjects, -NumPurgedObjects, MemoryOrder::eRelaxed) < 0)
+                Atomics::Store(PurgedShard.NumDeletedObjects, Long{ 0 }, MemoryOrder::eRelaxed);
+        }
+
+        /// Removes all expired references from the shard and returns their number.
+        /// Must be called while the shard's writer lock is held.
+        static uint32_t PurgeShard(Shard& PurgedShard)
+        {
+            uint32_t NumPurgedObjects = 0;
+
+            Table* pTable = PurgedShard.pTable.load(std::memory_order_relaxed);
+            for (uint32_t i = 0; i < pTable->Capacity; ++i)
+            {
+                if (PurgeSlot(PurgedShard, pTable, i))
+                    ++NumPurgedObjects;
+            }
+
+            Atomics::Store(PurgedShard.NumDeletedObjects, Long{ 0 }, MemoryOrder::eRelaxed);
+            return NumPurgedObjects;
+        }
+
+        /// Advances the shard's epoch if it can and frees the retired entries and tables no lookup can reach any
+        /// more, or all of them if bAll is set. Must be called while the shard's writer lock is held.
+        void ReclaimRetired(Shard& ReclaimedShard, bool bAll)
+        {
+            ReclaimedShard.Epochs.TryAdvance();
+
+            Entry** ppEntry = &ReclaimedShard.pRetiredEntries;
+            while (Entry* pEntry = *ppEntry)
+            {
+                if (bAll || ReclaimedShard.Epochs.IsReclaimable(pEntry->RetireEpoch))
+                {
+                    *ppEntry = pEntry->pNextRetired;
+                    DestroyEntry(pEntry);
+                }
+                else
+                    ppEntry = &pEntry->pNextRetired;
+            }
+
+            Table** ppTable = &ReclaimedShard.pRetiredTables;
+            while (Table* pTable = *ppTable)
+            {
+                if (bAll || ReclaimedShard.Epochs.IsReclaimable(pTable->RetireEpoch))
+                {
+                    *ppTable = pTable->pNextRetired;
+                    DestroyTable(pTable);
+                }
+                else
+                    ppTable = &pTable->pNextRetired;
+            }
+        }
 
-        /// Nmber of outstanding deleted objects that have not been purged
-        Atomics::AtomicLong m_NumDeletedObjects;
+        IMemoryAllocator& m_RawAllocator;
 
-        /// Hash map that stores weak pointers to the referenced objects
-        
-        std::unordered_map<ResourceDescType, WeakPtr<IObject>, std::hash<ResourceDescType>, std::equal_to<ResourceDescType>, STDAllocatorRawMem<HashMapElem>> m_DescToObjHashMap;
+        Shard* m_pShards = nullptr;
     };
-}
\ No newline at end of file
+}
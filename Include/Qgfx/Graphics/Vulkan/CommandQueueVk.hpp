@@ -4,6 +4,7 @@
 #include <mutex>
 #include <deque>
 #include <queue>
+#include <memory_resource>
 
 #include "BaseVk.hpp"
 #include "MemAllocVk.hpp"
@@ -12,6 +13,8 @@
 
 #include "../ICommandQueue.hpp"
 
+#include "../../Common/LinearAllocator.hpp"
+#include "../../Common/MemoryResource.hpp"
 #include "../../Common/PoolAllocator.hpp"
 
 namespace Qgfx
@@ -129,13 +132,16 @@ namespace Qgfx
 		uint64_t m_CompletedSubmissionIndex = 0;
 		uint64_t m_NextSubmissionIndex = 1;
 
+		// Backs the deferred release lists below. Only accessed while m_Mutex is locked.
+		PoolMemoryResource m_ReleaseListsMemory;
+
 		struct SubmissionFence
 		{
 			uint64_t Index;
 			vk::Fence CompletetionFence;
 		};
 
-		std::deque<SubmissionFence> m_SubmissionFences;
+		std::pmr::deque<SubmissionFence> m_SubmissionFences;
 
 		struct CommandBufferToFree
 		{
@@ -143,7 +149,7 @@ namespace Qgfx
 			CommandPoolAndBuffer PoolAndBuffer;
 		};
 
-		std::deque<CommandBufferToFree> m_CommandBuffersToFree;
+		std::pmr::deque<CommandBufferToFree> m_CommandBuffersToFree;
 
 		struct SemaphoreToDelete
 		{
@@ -151,7 +157,7 @@ namespace Qgfx
 			vk::Semaphore Semaphore;
 		};
 
-		std::deque<SemaphoreToDelete> m_SemaphoresToDelete;
+		std::pmr::deque<SemaphoreToDelete> m_SemaphoresToDelete;
 
 		struct TextureToDelete
 		{
@@ -160,7 +166,7 @@ namespace Qgfx
 			VmaAllocation Allocation;
 		};
 
-		std::deque<TextureToDelete> m_TexturesToDelete;
+		std::pmr::deque<TextureToDelete> m_TexturesToDelete;
 
 		//////////////////////////
 		// Handles ///////////////
@@ -170,6 +176,10 @@ namespace Qgfx
 
 		FixedBlockMemoryAllocator m_CommandBufferObjectAllocator;
 
+		// Scratch memory for submit infos. Chunks are tagged with the submission index and recycled
+		// by CheckPendingSubmissions() once that submission has completed.
+		LinearAllocator m_SubmitScratchAllocator;
+
 		FencePoolVk m_FencePool;
 
 		BinarySemaphorePoolVk m_AcquiredSemaphorePool;
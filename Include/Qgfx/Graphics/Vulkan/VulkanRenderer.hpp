@@ -3,6 +3,7 @@
 #include "VulkanBase.hpp"
 
 #include "../IRenderer.hpp"
+#include "../../Common/HybridLock.hpp"
 
 namespace Qgfx
 {
@@ -185,7 +186,8 @@ namespace Qgfx
 			std::vector<Queue> Queues;
 		};
 
-		std::mutex m_SubmitMutex;
+		// Submits are short, so waiters spin briefly before parking
+		HybridLockFlag m_SubmitLockFlag;
 
 		uint32_t m_GraphicsQueueFamilyIndex;
 		uint32_t m_TransferQueueFamilyIndex;
@@ -215,8 +217,6 @@ namespace Qgfx
 
 	private:
 
-		std::mutex m_AllocMutex;
-
 		FixedBlockMemoryAllocator m_CommandBufferObjAllocator;
 
 		std::mutex m_Mutex;
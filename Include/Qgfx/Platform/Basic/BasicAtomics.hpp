@@ -3,6 +3,7 @@
 #include <atomic>
 #include <cstdint>
 
+#include "../MemoryOrder.hpp"
 #include "../Numerics.hpp"
 
 namespace Qgfx
@@ -43,10 +44,77 @@ namespace Qgfx
             return Comparand;
         }
 
+        // The function returns the resulting value.
         template <typename Type>
         static inline Type Add(std::atomic<Type> &Destination, Type Val)
         {
-            return std::atomic_fetch_add(&Destination, Val);
+            return std::atomic_fetch_add(&Destination, Val) + Val;
+        }
+
+        // Variants with an explicit memory order. The functions above are sequentially consistent.
+
+        template <typename Type>
+        static inline Type Increment(std::atomic<Type> &Val, MemoryOrder Order)
+        {
+            return Val.fetch_add(1, ToStdMemoryOrder(Order)) + 1;
+        }
+
+        template <typename Type>
+        static inline Type Decrement(std::atomic<Type> &Val, MemoryOrder Order)
+        {
+            return Val.fetch_sub(1, ToStdMemoryOrder(Order)) - 1;
+        }
+
+        // Order must not be eRelease or eAcquireRelease
+        template <typename Type>
+        static inline Type Load(std::atomic<Type>& Val, MemoryOrder Order)
+        {
+            return Val.load(ToStdMemoryOrder(Order));
+        }
+
+        // Order must not be eAcquire or eAcquireRelease
+        template <typename Type>
+        static inline void Store(std::atomic<Type>& Val, Type NewVal, MemoryOrder Order = MemoryOrder::eSequentiallyConsistent)
+        {
+            Val.store(NewVal, ToStdMemoryOrder(Order));
+        }
+
+        // Order applies if the exchange succeeds. A failed exchange is only a load, and is relaxed
+        // unless Order includes acquire semantics.
+        template <typename Type>
+        static inline Type CompareExchange(std::atomic<Type> &Destination, Type Exchange, Type Comparand, MemoryOrder Order)
+        {
+            Destination.compare_exchange_strong(Comparand, Exchange, ToStdMemoryOrder(Order), ToStdFailureMemoryOrder(Order));
+            return Comparand;
+        }
+
+        template <typename Type>
+        static inline Type Add(std::atomic<Type> &Destination, Type Val, MemoryOrder Order)
+        {
+            return Destination.fetch_add(Val, ToStdMemoryOrder(Order)) + Val;
+        }
+
+        static inline void ThreadFence(MemoryOrder Order)
+        {
+            std::atomic_thread_fence(ToStdMemoryOrder(Order));
+        }
+
+    private:
+        static constexpr std::memory_order ToStdMemoryOrder(MemoryOrder Order)
+        {
+            return Order == MemoryOrder::eRelaxed ? std::memory_order_relaxed :
+                Order == MemoryOrder::eAcquire ? std::memory_order_acquire :
+                Order == MemoryOrder::eRelease ? std::memory_order_release :
+                Order == MemoryOrder::eAcquireRelease ? std::memory_order_acq_rel :
+                std::memory_order_seq_cst;
+        }
+
+        // The failure order of a compare-exchange cannot contain release semantics
+        static constexpr std::memory_order ToStdFailureMemoryOrder(MemoryOrder Order)
+        {
+            return Order == MemoryOrder::eAcquire || Order == MemoryOrder::eAcquireRelease ? std::memory_order_acquire :
+                Order == MemoryOrder::eSequentiallyConsistent ? std::memory_order_seq_cst :
+                std::memory_order_relaxed;
         }
     };
 }
@@ -0,0 +1,134 @@
+#pragma once
+
+#if !QGFX_PLATFORM_LINUX
+#error QGFX_PLATFORM_LINUX must be defined to include LinuxVirtualMemoryAllocator.hpp
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "../../Common/MemoryAllocator.hpp"
+
+namespace Qgfx
+{
+    struct VirtualMemoryAllocatorDesc
+    {
+        /// Size of the virtual address range to reserve. Rounded up to the commit granularity.
+        size_t ReserveSize = size_t{ 1 } << 32;
+
+        /// Back the range with explicit huge pages (MAP_HUGETLB). These must have been reserved by the
+        /// administrator, so if the mapping fails the allocator falls back to transparent huge pages.
+        bool bUseHugeTLB = false;
+
+        /// Ask for transparent huge pages (MADV_HUGEPAGE) when explicit huge pages are not used.
+        bool bUseTransparentHugePages = true;
+
+        /// NUMA node to bind committed memory to, or -1 to use the default policy of the thread.
+        int NumaNode = -1;
+    };
+
+    /// Raw allocator for large, long-lived blocks such as FixedBlockMemoryAllocator pages.
+
+    /// The allocator reserves one large virtual address range up front and commits it incrementally,
+    /// CommitGranularity bytes at a time, as allocations reach further into it. The range is backed by
+    /// huge pages where possible, which reduces TLB misses on paths that touch many pool pages, and
+    /// the committed size only grows with the high-water mark of the allocations.
+    ///
+    /// Requests are rounded up to a power of two of at least MinBlockSize bytes, and every block is
+    /// aligned to its size. Blocks are managed as buddies: a freed block is merged with the other half of
+    /// the block twice its size whenever that half is free too, and larger free blocks are split to serve
+    /// smaller requests. Free blocks of CommitGranularity bytes or more are returned to the system with
+    /// MADV_DONTNEED, which drops them from the resident set while they stay committed. Requests that do
+    /// not fit into the reserved range go to DefaultRawMemoryAllocator.
+    class LinuxVirtualMemoryAllocator final : public IMemoryAllocator
+    {
+    public:
+        static constexpr size_t MinBlockSize = 4096;
+        static constexpr size_t CommitGranularity = size_t{ 2 } << 20;
+
+        explicit LinuxVirtualMemoryAllocator(const VirtualMemoryAllocatorDesc& Desc = VirtualMemoryAllocatorDesc{});
+        ~LinuxVirtualMemoryAllocator();
+
+        /// Allocates block of memory
+        virtual void* Allocate(size_t Size) override final;
+
+        /// Allocates block of memory aligned to Alignment
+        virtual void* Allocate(size_t Size, size_t Alignment) override final;
+
+        /// Releases memory
+        virtual void Free(void* Ptr) override final;
+
+#if QGFX_MEMORY_STATISTICS
+        /// Returns the allocation counters of the blocks taken from the reserved range
+        virtual MemoryStatistics* GetStatistics() override final { return &m_Statistics; }
+#endif
+
+        /// Returns the number of bytes that have been committed so far, including free blocks that have
+        /// been returned to the system
+        size_t GetCommittedSize();
+
+        bool IsUsingHugeTLB() const { return m_bHugeTLB; }
+
+        static LinuxVirtualMemoryAllocator& GetAllocator();
+
+    private:
+        // clang-format off
+        LinuxVirtualMemoryAllocator(const LinuxVirtualMemoryAllocator&) = delete;
+        LinuxVirtualMemoryAllocator(LinuxVirtualMemoryAllocator&&) = delete;
+        LinuxVirtualMemoryAllocator& operator = (const LinuxVirtualMemoryAllocator&) = delete;
+        LinuxVirtualMemoryAllocator& operator = (LinuxVirtualMemoryAllocator&&) = delete;
+        // clang-format on
+
+        static constexpr uint32_t MinBlockSizeLog2 = 12;
+        static constexpr uint32_t CommitGranularityLog2 = 21;
+        static constexpr uint32_t MaxSizeClasses = 64;
+
+        // Set in the block size table for blocks that are free
+        static constexpr uint8_t  FreeBlockFlag = 0x80;
+        static constexpr uint32_t InvalidGranule = ~0u;
+
+        // Links of a free block to the previous and next free blocks of its size, as granule indices
+        struct FreeBlockLinks
+        {
+            uint32_t Prev;
+            uint32_t Next;
+        };
+
+        bool  Contains(const void* Ptr) const { return Ptr >= m_pBase && Ptr < m_pBase + m_ReserveSize; }
+        void* AllocateFromRange(uint32_t SizeLog2);
+        bool  Commit(uint8_t* pCommitEnd);
+        void  PushFreeBlock(uint8_t* pBlock, uint32_t SizeLog2);
+        void  RemoveFreeBlock(uint32_t Granule, uint32_t SizeLog2);
+
+        static size_t GetTablesSize(size_t ReserveSize) { return ReserveSize / MinBlockSize * (sizeof(FreeBlockLinks) + 1); }
+
+        uint32_t GetGranule(const uint8_t* pBlock) const { return static_cast<uint32_t>((pBlock - m_pBase) / MinBlockSize); }
+
+        std::mutex m_Mutex;
+
+        uint8_t* m_pBase = nullptr;
+        size_t   m_ReserveSize = 0;
+        uint8_t* m_pNext = nullptr;       // Start of the never allocated part of the range
+        uint8_t* m_pCommitEnd = nullptr;  // End of the committed part of the range
+        bool     m_bHugeTLB = false;
+        int      m_NumaNode = -1;
+
+        // Log2 of the size of the block that starts at every MinBlockSize granule of the range, with
+        // FreeBlockFlag set if the block is free. Free() uses it to find out the size of a block, and
+        // whether its buddy is free.
+        uint8_t* m_pBlockSizeLog2 = nullptr;
+
+        // Links of the free block that starts at every granule. They are kept out of the blocks, so that
+        // free blocks that have been returned to the system are not touched, and faulted back in, again.
+        FreeBlockLinks* m_pFreeBlockLinks = nullptr;
+
+        // First free block of every size, as a granule index, and a bit for every size that has one
+        uint32_t m_FreeBlocks[MaxSizeClasses];
+        uint64_t m_FreeBlockMask = 0;
+
+#if QGFX_MEMORY_STATISTICS
+        MemoryStatistics m_Statistics;
+#endif
+    };
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace Qgfx
+{
+	/// Ordering constraint of an atomic operation, mirrors std::memory_order.
+	enum class MemoryOrder
+	{
+		/// Only the operation itself is atomic, no ordering is imposed on other memory accesses
+		eRelaxed = 0,
+		/// No reads or writes that follow the operation can be moved before it
+		eAcquire,
+		/// No reads or writes that precede the operation can be moved after it
+		eRelease,
+		/// Both eAcquire and eRelease, for read-modify-write operations
+		eAcquireRelease,
+		/// eAcquireRelease, plus a single total order of all such operations
+		eSequentiallyConsistent
+	};
+}
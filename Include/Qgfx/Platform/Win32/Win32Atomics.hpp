@@ -6,6 +6,7 @@
 
 #include <cstdint>
 
+#include "../MemoryOrder.hpp"
 #include "../Numerics.hpp"
 
 namespace Qgfx
@@ -32,9 +33,37 @@ namespace Qgfx
         // to the Comparand value, the Exchange value is stored in the address specified by Destination.
         // Otherwise, no operation is performed.
         // The function returns the initial value of the Destination parameter
-        static Numerics::Long CompareExchange(WindowsAtomics::AtomicLong& Destination, Long Exchange, Long Comparand);
+        static Numerics::Long  CompareExchange(WindowsAtomics::AtomicLong& Destination, Numerics::Long Exchange, Numerics::Long Comparand);
+        static Numerics::Int64 CompareExchange(WindowsAtomics::AtomicInt64& Destination, Numerics::Int64 Exchange, Numerics::Int64 Comparand);
 
+        // The function returns the resulting value.
         static Numerics::Long  Add(WindowsAtomics::AtomicLong& Destination, Numerics::Long Val);
         static Numerics::Int64 Add(WindowsAtomics::AtomicInt64& Destination, Numerics::Int64 Val);
+
+        // Variants with an explicit memory order. The functions above are sequentially consistent.
+        // x86 and x64 only have full-fence interlocked operations, so the order only makes a difference
+        // to the code the compiler may move around the operation there. ARM64 uses the weaker instructions.
+
+        static Numerics::Long  Increment(WindowsAtomics::AtomicLong& Val, MemoryOrder Order);
+        static Numerics::Int64 Increment(WindowsAtomics::AtomicInt64& Val, MemoryOrder Order);
+
+        static Numerics::Long  Decrement(WindowsAtomics::AtomicLong& Val, MemoryOrder Order);
+        static Numerics::Int64 Decrement(WindowsAtomics::AtomicInt64& Val, MemoryOrder Order);
+
+        // Order must not be eRelease or eAcquireRelease
+        static Numerics::Long  Load(WindowsAtomics::AtomicLong& Val, MemoryOrder Order);
+        static Numerics::Int64 Load(WindowsAtomics::AtomicInt64& Val, MemoryOrder Order);
+
+        // Order must not be eAcquire or eAcquireRelease
+        static void Store(WindowsAtomics::AtomicLong& Val, Numerics::Long NewVal, MemoryOrder Order = MemoryOrder::eSequentiallyConsistent);
+        static void Store(WindowsAtomics::AtomicInt64& Val, Numerics::Int64 NewVal, MemoryOrder Order = MemoryOrder::eSequentiallyConsistent);
+
+        static Numerics::Long  CompareExchange(WindowsAtomics::AtomicLong& Destination, Numerics::Long Exchange, Numerics::Long Comparand, MemoryOrder Order);
+        static Numerics::Int64 CompareExchange(WindowsAtomics::AtomicInt64& Destination, Numerics::Int64 Exchange, Numerics::Int64 Comparand, MemoryOrder Order);
+
+        static Numerics::Long  Add(WindowsAtomics::AtomicLong& Destination, Numerics::Long Val, MemoryOrder Order);
+        static Numerics::Int64 Add(WindowsAtomics::AtomicInt64& Destination, Numerics::Int64 Val, MemoryOrder Order);
+
+        static void ThreadFence(MemoryOrder Order);
     };
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Qgfx/Common/DebugOutput.hpp"
+#include "Qgfx/Common/LockProfiler.hpp"
 
 #include <mutex>
 #include <iostream>
@@ -13,7 +14,7 @@ namespace Qgfx
 
 	void SetDebugMessageCallback(DebugMessageCallbackType DbgMessageCallback)
 	{
-		std::lock_guard Lock(g_DebugMessageMutex);
+		QGFX_LOCK_GUARD(Lock, g_DebugMessageMutex, "g_DebugMessageMutex");
 		g_DebugMessageCallback = DbgMessageCallback;
 	}
 
@@ -25,7 +26,7 @@ namespace Qgfx
 
 	void WriteDebugMessage(DebugMessageSeverity Severity, const char* Message, const char* Function, const char* File, int Line)
 	{
-		std::lock_guard Lock(g_DebugMessageMutex);
+		QGFX_LOCK_GUARD(Lock, g_DebugMessageMutex, "g_DebugMessageMutex");
 		if (g_DebugMessageCallback)
 		{
 			g_DebugMessageCallback(Severity, Message, Function, File, Line);
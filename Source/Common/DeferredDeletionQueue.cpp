@@ -0,0 +1,55 @@
+#include "Qgfx/Common/DeferredDeletionQueue.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Qgfx
+{
+    DeferredDeletionQueue::DeferredDeletionQueue(IMemoryAllocator& RawMemoryAllocator) :
+        m_DrainList{ STDAllocatorRawMem<DrainEntry>(RawMemoryAllocator) }
+    {
+    }
+
+    DeferredDeletionQueue::~DeferredDeletionQueue()
+    {
+        Drain();
+    }
+
+    size_t DeferredDeletionQueue::Drain()
+    {
+#ifdef QGFX_DEBUG
+        QGFX_VERIFY(!m_bDraining, "Drain() must not be called concurrently, or from a destructor it runs");
+        m_bDraining = true;
+#endif
+
+        size_t NumDestroyed = 0;
+
+        // Destructors may release the last reference to other objects, which are retired again,
+        // so keep going until nothing is left
+        while (Node* pNode = m_pHead.exchange(nullptr, std::memory_order_acquire))
+        {
+            m_DrainList.clear();
+            for (; pNode != nullptr; pNode = pNode->pNext)
+                m_DrainList.push_back(DrainEntry{ pNode, m_DrainList.size() });
+
+            // Group the objects by type so that the code and data a destructor touches stay in the cache
+            // while the objects of its type are destroyed, and destroy them in retire order within a type
+            std::sort(m_DrainList.begin(), m_DrainList.end(), [](const DrainEntry& Lhs, const DrainEntry& Rhs) {
+                const uintptr_t LhsType = reinterpret_cast<uintptr_t>(Lhs.pNode->pfnDestroy);
+                const uintptr_t RhsType = reinterpret_cast<uintptr_t>(Rhs.pNode->pfnDestroy);
+                return LhsType != RhsType ? LhsType < RhsType : Lhs.StackIndex > Rhs.StackIndex;
+            });
+
+            for (const DrainEntry& Entry : m_DrainList)
+                Entry.pNode->pfnDestroy(Entry.pNode);
+
+            NumDestroyed += m_DrainList.size();
+        }
+
+#ifdef QGFX_DEBUG
+        m_bDraining = false;
+#endif
+
+        return NumDestroyed;
+    }
+}
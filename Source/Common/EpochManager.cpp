@@ -0,0 +1,67 @@
+#include "Qgfx/Common/EpochManager.hpp"
+#include "Qgfx/Common/ThreadIndex.hpp"
+
+namespace Qgfx
+{
+    static_assert((EpochManager::NumStripes & (EpochManager::NumStripes - 1)) == 0, "NumStripes must be a power of two");
+
+    EpochManager::EpochManager() noexcept :
+        m_Epoch{ 0 }
+    {
+        for (Stripe& ReaderStripe : m_Stripes)
+        {
+            for (AtomicLong& NumReaders : ReaderStripe.NumReaders)
+                Atomics::Store(NumReaders, Long{ 0 }, MemoryOrder::eRelaxed);
+        }
+    }
+
+    uint32_t EpochManager::Enter() noexcept
+    {
+        Stripe& ReaderStripe = m_Stripes[GetCurrentThreadIndex() & (NumStripes - 1)];
+
+        for (;;)
+        {
+            // The increment and the second load of the epoch must not be reordered, and neither must the
+            // writer's loads of the counts and its store of the epoch, so both sides are sequentially
+            // consistent. Then either the writer sees this reader, or the reader sees that the epoch moved
+            // on while it was counting itself and tries again in the new one.
+            const Int64    Epoch = Atomics::Load(m_Epoch);
+            const uint32_t Slot = static_cast<uint32_t>(Epoch % NumEpochSlots);
+
+            Atomics::Increment(ReaderStripe.NumReaders[Slot]);
+            if (Atomics::Load(m_Epoch) == Epoch)
+                return static_cast<uint32_t>(&ReaderStripe - m_Stripes) * NumEpochSlots + Slot;
+
+            Atomics::Decrement(ReaderStripe.NumReaders[Slot], MemoryOrder::eRelease);
+        }
+    }
+
+    void EpochManager::Leave(uint32_t Token) noexcept
+    {
+        QGFX_VERIFY_EXPR(Token < NumStripes * NumEpochSlots);
+
+        // Release, so that the reads made in the section complete before a writer may free what was read
+        const Long NumReaders = Atomics::Decrement(m_Stripes[Token / NumEpochSlots].NumReaders[Token % NumEpochSlots], MemoryOrder::eRelease);
+        QGFX_VERIFY(NumReaders >= 0, "Inconsistent call to Leave()");
+        (void)NumReaders;
+    }
+
+    bool EpochManager::TryAdvance() noexcept
+    {
+        // Only writers store the epoch, and their calls do not overlap
+        const Int64    Epoch = Atomics::Load(m_Epoch, MemoryOrder::eRelaxed);
+        const uint32_t PrevSlot = static_cast<uint32_t>((Epoch + NumEpochSlots - 1) % NumEpochSlots);
+
+        // Only the readers of the previous epoch hold it back. A reader that is left in epoch E keeps the
+        // epoch from reaching E + 2, which is when the objects it may have seen become reclaimable.
+        for (Stripe& ReaderStripe : m_Stripes)
+        {
+            // Sequentially consistent, which also acquires the reads of the readers that left
+            if (Atomics::Load(ReaderStripe.NumReaders[PrevSlot]) != 0)
+                return false;
+        }
+
+        Atomics::Store(m_Epoch, Epoch + 1);
+        return true;
+    }
+}
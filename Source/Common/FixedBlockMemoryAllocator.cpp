@@ -1,5 +1,6 @@
 #include "Qgfx/Common/FixedBlockMemoryAllocator.hpp"
 #include "Qgfx/Common/Align.hpp"
+#include "Qgfx/Common/ThreadIndex.hpp"
 
 #include <algorithm>
 
@@ -12,36 +13,99 @@ namespace Qgfx
 
     FixedBlockMemoryAllocator::FixedBlockMemoryAllocator(IMemoryAllocator& RawMemoryAllocator,
         size_t            BlockSize,
-        uint32_t            NumBlocksInPage) :
+        uint32_t            NumBlocksInPage,
+        uint32_t            ThreadCacheSize,
+        uint32_t            MaxSparePages) :
         // clang-format off
-        m_PagePool(STDAllocatorRawMem<MemoryPage>(RawMemoryAllocator)),
-        m_AvailablePages(STDAllocatorRawMem<size_t>(RawMemoryAllocator)),
-        m_AddrToPageId(STDAllocatorRawMem<AddrToPageIdMapElem>(RawMemoryAllocator)),
         m_RawMemoryAllocator{ RawMemoryAllocator },
         m_BlockSize{ AdjustBlockSize(BlockSize) },
-        m_NumBlocksInPage{ NumBlocksInPage }
+        m_BlockAlignment{ std::min(m_BlockSize & (~m_BlockSize + 1), CacheLineSize) },
+        m_FirstBlockOffset{ GetPageHeaderSize() },
+        m_PageSize{ AlignUpToPowerOfTwo(m_FirstBlockOffset + m_BlockSize * std::max(NumBlocksInPage, uint32_t{ 1 })) },
+        m_NumBlocksInPage{ static_cast<uint32_t>((m_PageSize - m_FirstBlockOffset) / m_BlockSize) },
+        m_ThreadCacheSize{ ThreadCacheSize },
+        m_MaxSparePages{ MaxSparePages }
         // clang-format on
     {
-        // Allocate one page
-        CreateNewPage();
+        static_assert((NumThreadCaches & (NumThreadCaches - 1)) == 0, "Number of thread caches must be a power of two");
+
+        // Pages are created on first use, so allocators that are never used cost no memory
     }
 
     FixedBlockMemoryAllocator::~FixedBlockMemoryAllocator()
     {
-#ifdef QGFX_DEBUG
-        for (size_t p = 0; p < m_PagePool.size(); ++p)
+        FlushThreadCaches();
+
+        MemoryPage* pPage = m_pFirstPage;
+        while (pPage != nullptr)
         {
-            QGFX_VERIFY(!m_PagePool[p].HasAllocations(), "Memory leak detected: memory page has allocated block");
-            QGFX_VERIFY(m_AvailablePages.find(p) != m_AvailablePages.end(), "Memory page is not in the available page pool");
+            QGFX_VERIFY(!pPage->HasAllocations(), "Memory leak detected: memory page has allocated block");
+            MemoryPage* pNextPage = pPage->m_pNextPage;
+            MemoryPage::Destroy(pPage);
+            pPage = pNextPage;
         }
-#endif
+    }
+
+    size_t FixedBlockMemoryAllocator::GetPageHeaderSize()
+    {
+        return AlignUp(sizeof(MemoryPage), CacheLineSize);
     }
 
     void FixedBlockMemoryAllocator::CreateNewPage()
     {
-        m_PagePool.emplace_back(*this);
-        m_AvailablePages.insert(m_PagePool.size() - 1);
-        m_AddrToPageId.reserve(m_PagePool.size() * m_NumBlocksInPage);
+        MemoryPage* pPage = MemoryPage::Create(*this);
+
+        pPage->m_pNextPage = m_pFirstPage;
+        if (m_pFirstPage != nullptr)
+            m_pFirstPage->m_pPrevPage = pPage;
+        m_pFirstPage = pPage;
+
+        AddAvailablePage(pPage);
+        ++m_NumPages;
+        ++m_NumEmptyPages;
+    }
+
+    void FixedBlockMemoryAllocator::ReleasePage(MemoryPage* pPage)
+    {
+        QGFX_VERIFY(!pPage->HasAllocations(), "Releasing a page that has allocated blocks");
+
+        RemoveAvailablePage(pPage);
+
+        if (pPage->m_pPrevPage != nullptr)
+            pPage->m_pPrevPage->m_pNextPage = pPage->m_pNextPage;
+        else
+            m_pFirstPage = pPage->m_pNextPage;
+
+        if (pPage->m_pNextPage != nullptr)
+            pPage->m_pNextPage->m_pPrevPage = pPage->m_pPrevPage;
+
+        MemoryPage::Destroy(pPage);
+        --m_NumPages;
+        --m_NumEmptyPages;
+    }
+
+    void FixedBlockMemoryAllocator::AddAvailablePage(MemoryPage* pPage)
+    {
+        QGFX_VERIFY_EXPR(pPage->m_pPrevAvailablePage == nullptr && pPage->m_pNextAvailablePage == nullptr && pPage != m_pFirstAvailablePage);
+
+        pPage->m_pNextAvailablePage = m_pFirstAvailablePage;
+        if (m_pFirstAvailablePage != nullptr)
+            m_pFirstAvailablePage->m_pPrevAvailablePage = pPage;
+        m_pFirstAvailablePage = pPage;
+    }
+
+    void FixedBlockMemoryAllocator::RemoveAvailablePage(MemoryPage* pPage)
+    {
+        if (pPage->m_pPrevAvailablePage != nullptr)
+            pPage->m_pPrevAvailablePage->m_pNextAvailablePage = pPage->m_pNextAvailablePage;
+        else
+            m_pFirstAvailablePage = pPage->m_pNextAvailablePage;
+
+        if (pPage->m_pNextAvailablePage != nullptr)
+            pPage->m_pNextAvailablePage->m_pPrevAvailablePage = pPage->m_pPrevAvailablePage;
+
+        pPage->m_pPrevAvailablePage = nullptr;
+        pPage->m_pNextAvailablePage = nullptr;
     }
 
     void* FixedBlockMemoryAllocator::Allocate(size_t Size)
@@ -51,48 +115,309 @@ namespace Qgfx
         Size = AdjustBlockSize(Size);
         QGFX_VERIFY(m_BlockSize == Size, "Requested size (", Size, ") does not match the block size (", m_BlockSize, ")");
 
+        void* Ptr = nullptr;
+        if (m_ThreadCacheSize == 0)
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            AllocateFromPages(1, &Ptr);
+        }
+        else
+        {
+            ThreadCache& Cache = GetThreadCache();
+            SpinLock     CacheLock{ Cache.LockFlag };
+
+            if (Cache.NumBlocks == 0)
+            {
+                RefillThreadCache(Cache);
+            }
+
+            Ptr = Cache.pFirstBlock;
+            Cache.pFirstBlock = *reinterpret_cast<void**>(Ptr);
+            --Cache.NumBlocks;
+
+            dbgFillPattern(Ptr, MemoryPage::AllocatedBlockMemPattern, m_BlockSize);
+        }
+
+#if QGFX_MEMORY_STATISTICS
+        RecordBlockAllocation(Ptr);
+#endif
+        return Ptr;
+    }
+
+    void* FixedBlockMemoryAllocator::Allocate(size_t Size, size_t Alignment)
+    {
+        QGFX_VERIFY(IsPowerOfTwo(Alignment), "Alignment (", Alignment, ") must be power of 2");
+        QGFX_VERIFY(Alignment <= m_BlockAlignment, "Requested alignment (", Alignment, ") exceeds the block alignment (", m_BlockAlignment, ")");
+        (void)Alignment;
+        return Allocate(Size);
+    }
+
+    void FixedBlockMemoryAllocator::Free(void* Ptr)
+    {
+#if QGFX_MEMORY_STATISTICS
+        RecordBlockFree(Ptr);
+#endif
+
+        if (m_ThreadCacheSize == 0)
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            FreeToPages(1, &Ptr);
+            return;
+        }
+
+        ThreadCache& Cache = GetThreadCache();
+        SpinLock     CacheLock{ Cache.LockFlag };
+
+        dbgFillPattern(Ptr, MemoryPage::DeallocatedBlockMemPattern, m_BlockSize);
+        *reinterpret_cast<void**>(Ptr) = Cache.pFirstBlock;
+        Cache.pFirstBlock = Ptr;
+        ++Cache.NumBlocks;
+
+        if (Cache.NumBlocks > m_ThreadCacheSize)
+        {
+            // Keep half of the blocks so that alternating Allocate()/Free() calls
+            // at the boundary do not bounce blocks between the cache and the pages.
+            DrainThreadCache(Cache, m_ThreadCacheSize / 2);
+        }
+    }
+
+    void FixedBlockMemoryAllocator::AllocateBatch(uint32_t Count, void** ppBlocks)
+    {
+#if QGFX_MEMORY_STATISTICS
+        void** const ppFirstBlock = ppBlocks;
+        const uint32_t NumBlocks = Count;
+#endif
+
+        if (m_ThreadCacheSize != 0)
+        {
+            ThreadCache& Cache = GetThreadCache();
+            SpinLock     CacheLock{ Cache.LockFlag };
+
+            while (Count > 0 && Cache.NumBlocks > 0)
+            {
+                void* Ptr = Cache.pFirstBlock;
+                Cache.pFirstBlock = *reinterpret_cast<void**>(Ptr);
+                --Cache.NumBlocks;
+
+                dbgFillPattern(Ptr, MemoryPage::AllocatedBlockMemPattern, m_BlockSize);
+                *ppBlocks++ = Ptr;
+                --Count;
+            }
+        }
+
+        if (Count != 0)
+        {
+            // Whatever the cache could not provide comes straight from the pages rather than through
+            // a refill, which would cap the number of blocks taken under one lock at the cache size
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+            AllocateFromPages(Count, ppBlocks);
+        }
+
+#if QGFX_MEMORY_STATISTICS
+        for (uint32_t i = 0; i < NumBlocks; ++i)
+            RecordBlockAllocation(ppFirstBlock[i]);
+#endif
+    }
+
+    void FixedBlockMemoryAllocator::FreeBatch(uint32_t Count, void* const* ppBlocks)
+    {
+#if QGFX_MEMORY_STATISTICS
+        for (uint32_t i = 0; i < Count; ++i)
+            RecordBlockFree(ppBlocks[i]);
+#endif
+
+        if (m_ThreadCacheSize != 0)
+        {
+            ThreadCache& Cache = GetThreadCache();
+            SpinLock     CacheLock{ Cache.LockFlag };
+
+            while (Count > 0 && Cache.NumBlocks < m_ThreadCacheSize)
+            {
+                void* Ptr = *ppBlocks++;
+                --Count;
+
+                dbgFillPattern(Ptr, MemoryPage::DeallocatedBlockMemPattern, m_BlockSize);
+                *reinterpret_cast<void**>(Ptr) = Cache.pFirstBlock;
+                Cache.pFirstBlock = Ptr;
+                ++Cache.NumBlocks;
+            }
+        }
+
+        if (Count == 0)
+            return;
+
         std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        FreeToPages(Count, ppBlocks);
+    }
 
-        if (m_AvailablePages.empty())
+    void FixedBlockMemoryAllocator::FlushThreadCaches()
+    {
+        if (m_ThreadCacheSize == 0)
+            return;
+
+        for (ThreadCache& Cache : m_ThreadCaches)
         {
-            CreateNewPage();
+            SpinLock CacheLock{ Cache.LockFlag };
+            DrainThreadCache(Cache, 0);
         }
+    }
+
+    size_t FixedBlockMemoryAllocator::Trim(uint32_t NumSparePagesToKeep)
+    {
+        FlushThreadCaches();
 
-        auto  PageId = *m_AvailablePages.begin();
-        auto& Page = m_PagePool[PageId];
-        auto* Ptr = Page.Allocate();
-        m_AddrToPageId.insert(std::make_pair(Ptr, PageId));
-        if (!Page.HasSpace())
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+        size_t      NumReleasedPages = 0;
+        MemoryPage* pPage = m_pFirstPage;
+        while (pPage != nullptr && m_NumEmptyPages > NumSparePagesToKeep)
         {
-            m_AvailablePages.erase(m_AvailablePages.begin());
+            MemoryPage* pNextPage = pPage->m_pNextPage;
+            if (!pPage->HasAllocations())
+            {
+                ReleasePage(pPage);
+                ++NumReleasedPages;
+            }
+            pPage = pNextPage;
         }
 
-        return Ptr;
+        return NumReleasedPages * m_PageSize;
     }
 
-    void FixedBlockMemoryAllocator::Free(void* Ptr)
+    FixedBlockMemoryAllocator::PageStatistics FixedBlockMemoryAllocator::GetPageStatistics()
     {
         std::lock_guard<std::mutex> LockGuard(m_Mutex);
-        auto PageIdIt = m_AddrToPageId.find(Ptr);
-        if (PageIdIt != m_AddrToPageId.end())
+
+        PageStatistics Stats{};
+        Stats.NumPages = m_NumPages;
+        Stats.NumEmptyPages = m_NumEmptyPages;
+        Stats.NumBlocksInPage = m_NumBlocksInPage;
+        Stats.PageSize = m_PageSize;
+        return Stats;
+    }
+
+#if QGFX_MEMORY_STATISTICS
+    void FixedBlockMemoryAllocator::RecordBlockAllocation(void* Ptr)
+    {
+        const MemoryTag Tag = MemoryTagScope::GetCurrentTag();
+        GetPage(Ptr)->SetBlockTag(Ptr, Tag);
+        m_Statistics.RecordAllocation(m_BlockSize, Tag);
+    }
+
+    void FixedBlockMemoryAllocator::RecordBlockFree(void* Ptr)
+    {
+        m_Statistics.RecordFree(m_BlockSize, GetPage(Ptr)->GetBlockTag(Ptr));
+    }
+#endif
+
+    FixedBlockMemoryAllocator::ThreadCache& FixedBlockMemoryAllocator::GetThreadCache()
+    {
+        return m_ThreadCaches[GetCurrentThreadIndex() & (NumThreadCaches - 1)];
+    }
+
+    void FixedBlockMemoryAllocator::RefillThreadCache(ThreadCache& Cache)
+    {
+        const uint32_t NumBlocksToFetch = std::max(m_ThreadCacheSize / 2, uint32_t{ 1 });
+
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+        for (uint32_t NumFetched = 0; NumFetched < NumBlocksToFetch;)
         {
-            auto PageId = PageIdIt->second;
-            QGFX_VERIFY_EXPR(PageId >= 0 && PageId < m_PagePool.size());
-            m_PagePool[PageId].Deallocate(Ptr);
-            m_AvailablePages.insert(PageId);
-            m_AddrToPageId.erase(PageIdIt);
-            if (m_AvailablePages.size() > 1 && !m_PagePool[PageId].HasAllocations())
+            void*          Blocks[MaxBlocksPerTransfer];
+            const uint32_t NumBlocks = std::min(NumBlocksToFetch - NumFetched, MaxBlocksPerTransfer);
+            AllocateFromPages(NumBlocks, Blocks);
+
+            for (uint32_t i = 0; i < NumBlocks; ++i)
             {
-                // In current implementation pages are never released!
-                // Note that if we delete a page, all indices past it will be invalid
+                *reinterpret_cast<void**>(Blocks[i]) = Cache.pFirstBlock;
+                Cache.pFirstBlock = Blocks[i];
+            }
+            NumFetched += NumBlocks;
+        }
+        Cache.NumBlocks += NumBlocksToFetch;
+    }
+
+    void FixedBlockMemoryAllocator::DrainThreadCache(ThreadCache& Cache, uint32_t NumBlocksToKeep)
+    {
+        if (Cache.NumBlocks <= NumBlocksToKeep)
+            return;
+
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
 
-                //m_PagePool.erase(m_PagePool.begin() + PageId);
-                //m_AvailablePages.erase(PageId);
+        while (Cache.NumBlocks > NumBlocksToKeep)
+        {
+            void*          Blocks[MaxBlocksPerTransfer];
+            const uint32_t NumBlocks = std::min(Cache.NumBlocks - NumBlocksToKeep, MaxBlocksPerTransfer);
+            for (uint32_t i = 0; i < NumBlocks; ++i)
+            {
+                Blocks[i] = Cache.pFirstBlock;
+                Cache.pFirstBlock = *reinterpret_cast<void**>(Blocks[i]);
             }
+            Cache.NumBlocks -= NumBlocks;
+
+            FreeToPages(NumBlocks, Blocks);
         }
-        else
+    }
+
+    void FixedBlockMemoryAllocator::AllocateFromPages(uint32_t Count, void** ppBlocks)
+    {
+        while (Count > 0)
         {
-            QGFX_UNEXPECTED("Address not found in the allocations list - double freeing memory?");
+            if (m_pFirstAvailablePage == nullptr)
+            {
+                CreateNewPage();
+            }
+
+            MemoryPage* pPage = m_pFirstAvailablePage;
+            if (!pPage->HasAllocations())
+            {
+                --m_NumEmptyPages;
+            }
+
+            // Take as many blocks as the page has, so the page lists are only updated once per page
+            const uint32_t NumAllocated = pPage->AllocateBatch(Count, ppBlocks);
+            if (!pPage->HasSpace())
+            {
+                RemoveAvailablePage(pPage);
+            }
+
+            ppBlocks += NumAllocated;
+            Count -= NumAllocated;
+        }
+    }
+
+    void FixedBlockMemoryAllocator::FreeToPages(uint32_t Count, void* const* ppBlocks)
+    {
+        uint32_t i = 0;
+        while (i < Count)
+        {
+            MemoryPage* pPage = GetPage(ppBlocks[i]);
+            QGFX_VERIFY(pPage->GetOwner() == this, "Address does not belong to this allocator");
+
+            // Blocks freed together were usually allocated together, so consecutive blocks tend
+            // to share a page. The page lists are updated once for every such run.
+            const bool bWasFull = !pPage->HasSpace();
+            do
+            {
+                pPage->Deallocate(ppBlocks[i]);
+                ++i;
+            } while (i < Count && GetPage(ppBlocks[i]) == pPage);
+
+            if (bWasFull)
+            {
+                AddAvailablePage(pPage);
+            }
+
+            if (!pPage->HasAllocations())
+            {
+                ++m_NumEmptyPages;
+                // Keep a few empty pages around so that an allocation pattern oscillating
+                // around a page boundary does not keep creating and releasing pages.
+                if (m_NumEmptyPages > m_MaxSparePages)
+                {
+                    ReleasePage(pPage);
+                }
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,67 @@
+#include "Qgfx/Common/HybridLock.hpp"
+
+#if QGFX_PLATFORM_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif QGFX_PLATFORM_WIN32
+#include <Windows.h>
+#else
+#include <thread>
+#endif
+
+namespace Qgfx
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+                  "The lock state must be a plain 32-bit integer for the operating system to wait on");
+
+    void HybridLock::LockContended(HybridLockFlag& LockFlag, int SpinCount) noexcept
+    {
+        // Holders usually leave quickly, so first wait a little without giving up the time slice
+        for (int i = 0; i < SpinCount; ++i)
+        {
+            SpinLock::Pause();
+            if (LockFlag.m_State.load(std::memory_order_relaxed) == HybridLockFlag::Unlocked && UnsafeTryLock(LockFlag))
+                return;
+        }
+
+        // Announce the waiter before parking, so that the holder's unlock wakes one. A thread taking the lock
+        // this way keeps the waiters state, as it cannot know whether other threads are still parked; the
+        // worst case is one wake-up nobody needed.
+        while (LockFlag.m_State.exchange(HybridLockFlag::LockedWithWaiters, std::memory_order_acquire) != HybridLockFlag::Unlocked)
+            Park(LockFlag, HybridLockFlag::LockedWithWaiters);
+    }
+
+#if QGFX_PLATFORM_LINUX
+    void HybridLock::Park(HybridLockFlag& LockFlag, uint32_t Value) noexcept
+    {
+        // Returns immediately if the state no longer holds Value, so an unlock cannot be missed
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&LockFlag.m_State), FUTEX_WAIT_PRIVATE, Value, nullptr, nullptr, 0);
+    }
+
+    void HybridLock::WakeWaiter(HybridLockFlag& LockFlag) noexcept
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&LockFlag.m_State), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+#elif QGFX_PLATFORM_WIN32
+    void HybridLock::Park(HybridLockFlag& LockFlag, uint32_t Value) noexcept
+    {
+        WaitOnAddress(&LockFlag.m_State, &Value, sizeof(Value), INFINITE);
+    }
+
+    void HybridLock::WakeWaiter(HybridLockFlag& LockFlag) noexcept
+    {
+        WakeByAddressSingle(&LockFlag.m_State);
+    }
+#else
+    void HybridLock::Park(HybridLockFlag& LockFlag, uint32_t Value) noexcept
+    {
+        // No way to wait on an address, degrade to yielding
+        std::this_thread::yield();
+    }
+
+    void HybridLock::WakeWaiter(HybridLockFlag& LockFlag) noexcept
+    {
+    }
+#endif
+}
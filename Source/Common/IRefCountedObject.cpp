@@ -0,0 +1,16 @@
+#include "Qgfx/Common/IRefCountedObject.hpp"
+#include "Qgfx/Common/FixedBlockMemoryAllocator.hpp"
+
+namespace Qgfx
+{
+    static_assert(sizeof(WeakRefCounter<MultiThreaded>) == sizeof(WeakRefCounter<SingleThreaded>) &&
+                  sizeof(WeakRefCounter<MultiThreaded>) == sizeof(WeakRefCounter<MultiThreadedHybridLock>),
+                  "Counters of all threading policies must fit the same block size");
+
+    IMemoryAllocator& GetWeakRefCounterAllocator()
+    {
+        // Never destroyed, as weak references held by other static objects may outlive any static allocator
+        static FixedBlockMemoryAllocator* const s_pAllocator = new FixedBlockMemoryAllocator{ DefaultRawMemoryAllocator::GetAllocator(), sizeof(WeakRefCounter<MultiThreaded>), 256 };
+        return *s_pAllocator;
+    }
+}
@@ -0,0 +1,155 @@
+#include "Qgfx/Common/LinearAllocator.hpp"
+#include "Qgfx/Common/Align.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+namespace Qgfx
+{
+    LinearAllocator::LinearAllocator(IMemoryAllocator& RawMemoryAllocator, size_t ChunkSize) :
+        // clang-format off
+        m_RawMemoryAllocator{ RawMemoryAllocator },
+        m_ChunkSize         { ChunkSize },
+        m_ChunkHeaderSize   { AlignUp(sizeof(Chunk), alignof(std::max_align_t)) }
+        // clang-format on
+    {
+        QGFX_VERIFY_EXPR(ChunkSize > 0);
+    }
+
+    LinearAllocator::~LinearAllocator()
+    {
+        if (m_pCurrentChunk != nullptr)
+            DestroyChunk(m_pCurrentChunk);
+
+        for (Chunk* pChunk = m_pFirstRetiredChunk; pChunk != nullptr;)
+        {
+            Chunk* pNextChunk = pChunk->pNext;
+            DestroyChunk(pChunk);
+            pChunk = pNextChunk;
+        }
+
+        ReleaseUnusedChunks();
+    }
+
+    void* LinearAllocator::Allocate(size_t Size)
+    {
+        QGFX_VERIFY_EXPR(Size > 0);
+        return Allocate(Size, alignof(std::max_align_t));
+    }
+
+    void* LinearAllocator::Allocate(size_t Size, size_t Alignment)
+    {
+        QGFX_VERIFY(IsPowerOfTwo(Alignment), "Alignment (", Alignment, ") must be power of 2");
+
+        uint8_t* pStart = AlignUp(m_pCurrent, Alignment);
+        if (m_pCurrentChunk == nullptr || pStart + Size > m_pEnd)
+        {
+            // Chunk data is aligned to alignof(std::max_align_t), larger alignments may need padding
+            const size_t MaxPadding = Alignment > alignof(std::max_align_t) ? Alignment - alignof(std::max_align_t) : 0;
+            if (Size + MaxPadding > m_ChunkSize)
+            {
+                // Too large for a regular chunk. The dedicated chunk is retired right away, so the
+                // current chunk keeps serving small allocations.
+                Chunk* pChunk = CreateChunk(Size + MaxPadding);
+                pChunk->Index = m_CurrentIndex;
+                RetireChunk(pChunk);
+                return AlignUp(GetChunkData(pChunk), Alignment);
+            }
+
+            if (m_pCurrentChunk != nullptr)
+                RetireChunk(m_pCurrentChunk);
+
+            Chunk* pChunk = m_pFirstFreeChunk;
+            if (pChunk != nullptr)
+                m_pFirstFreeChunk = pChunk->pNext;
+            else
+                pChunk = CreateChunk(m_ChunkSize);
+
+            BeginChunk(pChunk);
+            pStart = AlignUp(m_pCurrent, Alignment);
+        }
+
+        m_pCurrentChunk->Index = m_CurrentIndex;
+        m_pCurrent = pStart + Size;
+        return pStart;
+    }
+
+    void LinearAllocator::SetCurrentIndex(uint64_t Index)
+    {
+        QGFX_VERIFY(Index >= m_CurrentIndex, "Indices must not decrease");
+        m_CurrentIndex = Index;
+    }
+
+    void LinearAllocator::ReleaseCompleted(uint64_t CompletedIndex)
+    {
+        while (m_pFirstRetiredChunk != nullptr && m_pFirstRetiredChunk->Index <= CompletedIndex)
+        {
+            Chunk* pChunk = m_pFirstRetiredChunk;
+            m_pFirstRetiredChunk = pChunk->pNext;
+            if (m_pFirstRetiredChunk == nullptr)
+                m_pLastRetiredChunk = nullptr;
+
+            if (pChunk->Size == m_ChunkSize)
+            {
+                pChunk->pNext = m_pFirstFreeChunk;
+                m_pFirstFreeChunk = pChunk;
+            }
+            else
+            {
+                DestroyChunk(pChunk);
+            }
+        }
+
+        // Nothing in the current chunk is in use anymore, start over from its beginning
+        if (m_pCurrentChunk != nullptr && m_pCurrentChunk->Index <= CompletedIndex)
+        {
+            m_pCurrent = GetChunkData(m_pCurrentChunk);
+        }
+    }
+
+    void LinearAllocator::ReleaseUnusedChunks()
+    {
+        while (m_pFirstFreeChunk != nullptr)
+        {
+            Chunk* pChunk = m_pFirstFreeChunk;
+            m_pFirstFreeChunk = pChunk->pNext;
+            DestroyChunk(pChunk);
+        }
+    }
+
+    LinearAllocator::Chunk* LinearAllocator::CreateChunk(size_t DataSize)
+    {
+        void* pRawMemory = m_RawMemoryAllocator.Allocate(m_ChunkHeaderSize + DataSize);
+        return new (pRawMemory) Chunk{ nullptr, m_CurrentIndex, DataSize };
+    }
+
+    void LinearAllocator::DestroyChunk(Chunk* pChunk)
+    {
+        m_RawMemoryAllocator.Free(pChunk);
+    }
+
+    void LinearAllocator::RetireChunk(Chunk* pChunk)
+    {
+        if (pChunk == m_pCurrentChunk)
+        {
+            m_pCurrentChunk = nullptr;
+            m_pCurrent = nullptr;
+            m_pEnd = nullptr;
+        }
+
+        pChunk->pNext = nullptr;
+        if (m_pLastRetiredChunk != nullptr)
+            m_pLastRetiredChunk->pNext = pChunk;
+        else
+            m_pFirstRetiredChunk = pChunk;
+        m_pLastRetiredChunk = pChunk;
+    }
+
+    void LinearAllocator::BeginChunk(Chunk* pChunk)
+    {
+        m_pCurrentChunk = pChunk;
+        m_pCurrent = GetChunkData(pChunk);
+        m_pEnd = m_pCurrent + pChunk->Size;
+    }
+}
@@ -0,0 +1,113 @@
+#include "Qgfx/Common/LockProfiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace Qgfx
+{
+    // Sites register once, the first time their line runs, so a plain mutex is enough for the list
+    static std::mutex& GetLockSitesMutex()
+    {
+        static std::mutex s_Mutex;
+        return s_Mutex;
+    }
+
+    static LockSite* g_pFirstLockSite = nullptr;
+
+    static uint32_t GetHoldTimeBucket(Int64 HoldNs)
+    {
+        uint32_t Bucket = 0;
+        while (HoldNs > 1 && Bucket < LockProfile::NumHoldTimeBuckets - 1)
+        {
+            HoldNs >>= 1;
+            ++Bucket;
+        }
+        return Bucket;
+    }
+
+    LockSite::LockSite(const char* Name) :
+        m_Name{ Name }
+    {
+        std::lock_guard<std::mutex> LockGuard(GetLockSitesMutex());
+        m_pNextSite = g_pFirstLockSite;
+        g_pFirstLockSite = this;
+    }
+
+    Int64 LockSite::GetTimestampNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void LockSite::RecordAcquisition(bool bContended, Int64 WaitNs)
+    {
+        // Nothing is published through these counters, so relaxed increments keep the profiler out of the way
+        Atomics::Increment(m_NumAcquisitions, MemoryOrder::eRelaxed);
+        if (!bContended)
+            return;
+
+        Atomics::Increment(m_NumContendedAcquisitions, MemoryOrder::eRelaxed);
+        Atomics::Add(m_TotalWaitNs, WaitNs, MemoryOrder::eRelaxed);
+
+        Int64 MaxWaitNs = Atomics::Load(m_MaxWaitNs, MemoryOrder::eRelaxed);
+        while (MaxWaitNs < WaitNs)
+        {
+            const Int64 PrevMaxWaitNs = Atomics::CompareExchange(m_MaxWaitNs, WaitNs, MaxWaitNs, MemoryOrder::eRelaxed);
+            if (PrevMaxWaitNs == MaxWaitNs)
+                break;
+            MaxWaitNs = PrevMaxWaitNs;
+        }
+    }
+
+    void LockSite::RecordRelease(Int64 HoldNs)
+    {
+        Atomics::Add(m_TotalHoldNs, HoldNs, MemoryOrder::eRelaxed);
+        Atomics::Increment(m_HoldTimeHistogram[GetHoldTimeBucket(HoldNs)], MemoryOrder::eRelaxed);
+    }
+
+    std::vector<LockProfile> GetLockProfile()
+    {
+        std::vector<LockProfile> Profiles;
+
+        std::lock_guard<std::mutex> LockGuard(GetLockSitesMutex());
+        for (LockSite* pSite = g_pFirstLockSite; pSite != nullptr; pSite = pSite->m_pNextSite)
+        {
+            // Every line that takes a lock is its own site, the sites of one lock are reported together
+            auto It = std::find_if(Profiles.begin(), Profiles.end(), [pSite](const LockProfile& Profile) { return strcmp(Profile.Name, pSite->m_Name) == 0; });
+            if (It == Profiles.end())
+            {
+                Profiles.emplace_back();
+                It = Profiles.end() - 1;
+                It->Name = pSite->m_Name;
+            }
+
+            // Counters are read one by one, so a profile taken while other threads lock
+            // is only approximately consistent.
+            It->NumAcquisitions += Atomics::Load(pSite->m_NumAcquisitions, MemoryOrder::eRelaxed);
+            It->NumContendedAcquisitions += Atomics::Load(pSite->m_NumContendedAcquisitions, MemoryOrder::eRelaxed);
+            It->TotalWaitNs += Atomics::Load(pSite->m_TotalWaitNs, MemoryOrder::eRelaxed);
+            It->MaxWaitNs = std::max(It->MaxWaitNs, Atomics::Load(pSite->m_MaxWaitNs, MemoryOrder::eRelaxed));
+            It->TotalHoldNs += Atomics::Load(pSite->m_TotalHoldNs, MemoryOrder::eRelaxed);
+            for (uint32_t i = 0; i < LockProfile::NumHoldTimeBuckets; ++i)
+                It->HoldTimeHistogram[i] += Atomics::Load(pSite->m_HoldTimeHistogram[i], MemoryOrder::eRelaxed);
+        }
+
+        std::sort(Profiles.begin(), Profiles.end(), [](const LockProfile& Lhs, const LockProfile& Rhs) { return Lhs.TotalWaitNs > Rhs.TotalWaitNs; });
+        return Profiles;
+    }
+
+    void ResetLockProfile()
+    {
+        std::lock_guard<std::mutex> LockGuard(GetLockSitesMutex());
+        for (LockSite* pSite = g_pFirstLockSite; pSite != nullptr; pSite = pSite->m_pNextSite)
+        {
+            Atomics::Store(pSite->m_NumAcquisitions, Int64{ 0 }, MemoryOrder::eRelaxed);
+            Atomics::Store(pSite->m_NumContendedAcquisitions, Int64{ 0 }, MemoryOrder::eRelaxed);
+            Atomics::Store(pSite->m_TotalWaitNs, Int64{ 0 }, MemoryOrder::eRelaxed);
+            Atomics::Store(pSite->m_MaxWaitNs, Int64{ 0 }, MemoryOrder::eRelaxed);
+            Atomics::Store(pSite->m_TotalHoldNs, Int64{ 0 }, MemoryOrder::eRelaxed);
+            for (AtomicInt64& Bucket : pSite->m_HoldTimeHistogram)
+                Atomics::Store(Bucket, Int64{ 0 }, MemoryOrder::eRelaxed);
+        }
+    }
+}
@@ -1,8 +1,16 @@
 #include "Qgfx/Common/MemoryAllocator.hpp"
+#include "Qgfx/Common/Align.hpp"
 #include "Qgfx/Common/Error.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <memory>
+#include <new>
+
+#if QGFX_PLATFORM_WIN32
+#include <malloc.h>
+#endif
 
 namespace Qgfx
 {
@@ -11,14 +19,61 @@ namespace Qgfx
     }
 
     void* DefaultRawMemoryAllocator::Allocate(size_t Size)
+    {
+        return Allocate(Size, alignof(std::max_align_t));
+    }
+
+    void* DefaultRawMemoryAllocator::Allocate(size_t Size, size_t Alignment)
     {
         QGFX_VERIFY_EXPR(Size > 0);
-        return new uint8_t[Size];
+        QGFX_VERIFY(IsPowerOfTwo(Alignment), "Alignment (", Alignment, ") must be power of 2");
+
+        // posix_memalign() requires at least pointer alignment
+        Alignment = std::max(Alignment, sizeof(void*));
+
+#if QGFX_MEMORY_STATISTICS
+        // Keep the header in the padding in front of the returned pointer. For page-aligned
+        // requests this costs a whole extra page, which is acceptable for a diagnostic build.
+        const size_t Offset = AlignUp(sizeof(AllocationHeader), Alignment);
+        Size += Offset;
+#endif
+
+#if QGFX_PLATFORM_WIN32
+        void* Ptr = _aligned_malloc(Size, Alignment);
+#else
+        void* Ptr = nullptr;
+        if (posix_memalign(&Ptr, Alignment, Size) != 0)
+            Ptr = nullptr;
+#endif
+        if (Ptr == nullptr)
+            throw std::bad_alloc{};
+
+#if QGFX_MEMORY_STATISTICS
+        Ptr = reinterpret_cast<uint8_t*>(Ptr) + Offset;
+        const MemoryTag Tag = MemoryTagScope::GetCurrentTag();
+        new (reinterpret_cast<AllocationHeader*>(Ptr) - 1) AllocationHeader{ Size - Offset, static_cast<uint32_t>(Offset), Tag };
+        m_Statistics.RecordAllocation(Size - Offset, Tag);
+#endif
+
+        return Ptr;
     }
 
     void DefaultRawMemoryAllocator::Free(void* Ptr)
     {
-        delete[] reinterpret_cast<uint8_t*>(Ptr);
+#if QGFX_MEMORY_STATISTICS
+        if (Ptr == nullptr)
+            return;
+
+        const AllocationHeader& Header = *(reinterpret_cast<AllocationHeader*>(Ptr) - 1);
+        m_Statistics.RecordFree(Header.Size, Header.Tag);
+        Ptr = reinterpret_cast<uint8_t*>(Ptr) - Header.Offset;
+#endif
+
+#if QGFX_PLATFORM_WIN32
+        _aligned_free(Ptr);
+#else
+        free(Ptr);
+#endif
     }
 
     DefaultRawMemoryAllocator& DefaultRawMemoryAllocator::GetAllocator()
@@ -26,4 +81,4 @@ namespace Qgfx
         static DefaultRawMemoryAllocator Allocator;
         return Allocator;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,60 @@
+#include "Qgfx/Common/MemoryResource.hpp"
+#include "Qgfx/Common/Align.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace Qgfx
+{
+    void* MemoryResourceAdapter::do_allocate(size_t Bytes, size_t Alignment)
+    {
+        // memory_resource allows zero-sized requests, IMemoryAllocator does not
+        return m_Allocator.Allocate(std::max(Bytes, size_t{ 1 }), Alignment);
+    }
+
+    void MemoryResourceAdapter::do_deallocate(void* Ptr, size_t /*Bytes*/, size_t /*Alignment*/)
+    {
+        m_Allocator.Free(Ptr);
+    }
+
+    bool MemoryResourceAdapter::do_is_equal(const std::pmr::memory_resource& Other) const noexcept
+    {
+        if (this == &Other)
+            return true;
+
+        // Memory can be released through any adapter of the same allocator
+        const auto* pOtherAdapter = dynamic_cast<const MemoryResourceAdapter*>(&Other);
+        return pOtherAdapter != nullptr && &pOtherAdapter->m_Allocator == &m_Allocator;
+    }
+
+    void* MemoryResourceAllocator::Allocate(size_t Size)
+    {
+        return Allocate(Size, alignof(std::max_align_t));
+    }
+
+    void* MemoryResourceAllocator::Allocate(size_t Size, size_t Alignment)
+    {
+        QGFX_VERIFY_EXPR(Size > 0);
+        QGFX_VERIFY(IsPowerOfTwo(Alignment), "Alignment (", Alignment, ") must be power of 2");
+
+        // The header sits right before the returned pointer, and the resource allocation is padded
+        // so that the pointer keeps the requested alignment.
+        Alignment = std::max(Alignment, alignof(AllocationHeader));
+        const size_t Offset = AlignUp(sizeof(AllocationHeader), Alignment);
+
+        uint8_t* pStart = reinterpret_cast<uint8_t*>(m_pResource->allocate(Offset + Size, Alignment));
+        uint8_t* Ptr = pStart + Offset;
+        new (Ptr - sizeof(AllocationHeader)) AllocationHeader{ Offset + Size, Alignment };
+        return Ptr;
+    }
+
+    void MemoryResourceAllocator::Free(void* Ptr)
+    {
+        if (Ptr == nullptr)
+            return;
+
+        const AllocationHeader Header = *(reinterpret_cast<const AllocationHeader*>(Ptr) - 1);
+        const size_t           Offset = AlignUp(sizeof(AllocationHeader), Header.Alignment);
+        m_pResource->deallocate(reinterpret_cast<uint8_t*>(Ptr) - Offset, Header.Size, Header.Alignment);
+    }
+}
@@ -0,0 +1,109 @@
+#include "Qgfx/Common/MemoryStatistics.hpp"
+#include "Qgfx/Common/Error.hpp"
+
+namespace Qgfx
+{
+    static thread_local MemoryTag t_CurrentMemoryTag = MemoryTag::eGeneral;
+
+    const char* GetMemoryTagName(MemoryTag Tag)
+    {
+        switch (Tag)
+        {
+        case MemoryTag::eGeneral: return "General";
+        case MemoryTag::eDevice: return "Device";
+        case MemoryTag::eQueue: return "Queue";
+        case MemoryTag::eRegistry: return "Registry";
+        case MemoryTag::eSwapChain: return "SwapChain";
+        default:
+            QGFX_UNEXPECTED("Unexpected memory tag");
+            return "Unknown";
+        }
+    }
+
+    static uint32_t GetSizeBucket(size_t Size)
+    {
+        uint32_t Bucket = 0;
+        while (Size > 1 && Bucket < MemoryStatisticsSnapshot::NumSizeBuckets - 1)
+        {
+            Size >>= 1;
+            ++Bucket;
+        }
+        return Bucket;
+    }
+
+    void MemoryStatistics::RecordAllocation(size_t Size, MemoryTag Tag)
+    {
+        QGFX_VERIFY_EXPR(Tag < MemoryTag::eCount);
+
+        RecordAllocation(m_Total, static_cast<Int64>(Size));
+        RecordAllocation(m_Tags[static_cast<size_t>(Tag)], static_cast<Int64>(Size));
+        Atomics::Increment(m_SizeHistogram[GetSizeBucket(Size)]);
+    }
+
+    void MemoryStatistics::RecordFree(size_t Size, MemoryTag Tag)
+    {
+        QGFX_VERIFY_EXPR(Tag < MemoryTag::eCount);
+
+        RecordFree(m_Total, static_cast<Int64>(Size));
+        RecordFree(m_Tags[static_cast<size_t>(Tag)], static_cast<Int64>(Size));
+    }
+
+    void MemoryStatistics::RecordAllocation(Counters& Counters, Int64 Size)
+    {
+        const Int64 LiveBytes = Atomics::Add(Counters.LiveBytes, Size);
+        Atomics::Increment(Counters.LiveAllocations);
+        Atomics::Increment(Counters.TotalAllocations);
+
+        Int64 PeakBytes = Atomics::Load(Counters.PeakBytes);
+        while (PeakBytes < LiveBytes)
+        {
+            const Int64 PrevPeakBytes = Atomics::CompareExchange(Counters.PeakBytes, LiveBytes, PeakBytes);
+            if (PrevPeakBytes == PeakBytes)
+                break;
+            PeakBytes = PrevPeakBytes;
+        }
+    }
+
+    void MemoryStatistics::RecordFree(Counters& Counters, Int64 Size)
+    {
+        Atomics::Add(Counters.LiveBytes, -Size);
+        Atomics::Decrement(Counters.LiveAllocations);
+    }
+
+    void MemoryStatistics::ReadCounters(Counters& Counters, MemoryCounters& Result)
+    {
+        Result.LiveBytes = Atomics::Load(Counters.LiveBytes);
+        Result.LiveAllocations = Atomics::Load(Counters.LiveAllocations);
+        Result.PeakBytes = Atomics::Load(Counters.PeakBytes);
+        Result.TotalAllocations = Atomics::Load(Counters.TotalAllocations);
+    }
+
+    MemoryStatisticsSnapshot MemoryStatistics::GetSnapshot()
+    {
+        // Counters are read one by one, so a snapshot taken while other threads allocate
+        // is only approximately consistent.
+        MemoryStatisticsSnapshot Snapshot{};
+        ReadCounters(m_Total, Snapshot.Total);
+        for (size_t i = 0; i < static_cast<size_t>(MemoryTag::eCount); ++i)
+            ReadCounters(m_Tags[i], Snapshot.Tags[i]);
+        for (uint32_t i = 0; i < MemoryStatisticsSnapshot::NumSizeBuckets; ++i)
+            Snapshot.SizeHistogram[i] = Atomics::Load(m_SizeHistogram[i]);
+        return Snapshot;
+    }
+
+    MemoryTagScope::MemoryTagScope(MemoryTag Tag) :
+        m_PrevTag{ t_CurrentMemoryTag }
+    {
+        t_CurrentMemoryTag = Tag;
+    }
+
+    MemoryTagScope::~MemoryTagScope()
+    {
+        t_CurrentMemoryTag = m_PrevTag;
+    }
+
+    MemoryTag MemoryTagScope::GetCurrentTag()
+    {
+        return t_CurrentMemoryTag;
+    }
+}
@@ -0,0 +1,138 @@
+#include "Qgfx/Common/PoolAllocator.hpp"
+#include "Qgfx/Common/Align.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace Qgfx
+{
+    size_t PoolAllocator::GetSizeClassBlockSize(uint32_t SizeClass)
+    {
+        // 8, 16, ..., 64
+        if (SizeClass < 8)
+            return (SizeClass + 1) * SizeClassGranularity;
+
+        // 80, 96, 112, 128, 160, 192, 224, 256, 320, ...
+        const uint32_t Octave = (SizeClass - 8) / 4;
+        const uint32_t Step = (SizeClass - 8) % 4 + 1;
+        return (size_t{ 64 } << Octave) + Step * (size_t{ 16 } << Octave);
+    }
+
+    PoolAllocator::PoolAllocator(IMemoryAllocator& RawMemoryAllocator, size_t PageSize) :
+        // clang-format off
+        m_RawMemoryAllocator{ RawMemoryAllocator },
+        m_PageSize          { PageSize }
+        // clang-format on
+    {
+        static_assert(NumSizeClasses < 256, "Size class indices must fit into the lookup table");
+        QGFX_VERIFY(IsPowerOfTwo(PageSize), "Page size (", PageSize, ") must be power of 2");
+        QGFX_VERIFY(GetSizeClassBlockSize(NumSizeClasses - 1) == MaxSmallAllocationSize, "The largest size class must match MaxSmallAllocationSize");
+        QGFX_VERIFY(FixedBlockMemoryAllocator::GetPageHeaderSize() + MaxSmallAllocationSize <= PageSize, "Page size (", PageSize, ") is too small for the largest size class");
+
+        for (uint32_t SizeClass = 0; SizeClass < NumSizeClasses; ++SizeClass)
+        {
+            // Fill the whole page, so that every size class ends up with exactly m_PageSize-sized pages
+            const size_t   BlockSize = GetSizeClassBlockSize(SizeClass);
+            const uint32_t NumBlocksInPage = static_cast<uint32_t>((PageSize - FixedBlockMemoryAllocator::GetPageHeaderSize()) / BlockSize);
+            m_SizeClassAllocators[SizeClass].reset(new FixedBlockMemoryAllocator{ RawMemoryAllocator, BlockSize, NumBlocksInPage });
+            QGFX_VERIFY_EXPR(m_SizeClassAllocators[SizeClass]->GetPageSize() == PageSize);
+        }
+
+        uint32_t SizeClass = 0;
+        for (size_t i = 0; i <= MaxSmallAllocationSize / SizeClassGranularity; ++i)
+        {
+            while (GetSizeClassBlockSize(SizeClass) < i * SizeClassGranularity)
+                ++SizeClass;
+            m_SizeClassLookup[i] = static_cast<uint8_t>(SizeClass);
+        }
+    }
+
+    PoolAllocator::~PoolAllocator()
+    {
+    }
+
+    void* PoolAllocator::Allocate(size_t Size)
+    {
+        QGFX_VERIFY_EXPR(Size > 0);
+
+        if (Size > MaxSmallAllocationSize)
+            return AllocateLarge(Size, alignof(std::max_align_t));
+
+        FixedBlockMemoryAllocator& Allocator = *m_SizeClassAllocators[m_SizeClassLookup[(Size + SizeClassGranularity - 1) / SizeClassGranularity]];
+#if QGFX_MEMORY_STATISTICS
+        m_Statistics.RecordAllocation(Allocator.GetBlockSize(), MemoryTagScope::GetCurrentTag());
+#endif
+        return Allocator.Allocate(Allocator.GetBlockSize());
+    }
+
+    void* PoolAllocator::Allocate(size_t Size, size_t Alignment)
+    {
+        QGFX_VERIFY_EXPR(Size > 0);
+        QGFX_VERIFY(IsPowerOfTwo(Alignment), "Alignment (", Alignment, ") must be power of 2");
+
+        // Size classes that are multiples of the alignment are aligned to it as long as the alignment
+        // does not exceed the cache line size, and the smallest size class that fits a multiple of the
+        // alignment is always such a class.
+        const size_t AlignedSize = AlignUp(Size, Alignment);
+        if (Alignment > CacheLineSize || AlignedSize > MaxSmallAllocationSize)
+            return AllocateLarge(Size, Alignment);
+
+        FixedBlockMemoryAllocator& Allocator = *m_SizeClassAllocators[m_SizeClassLookup[(AlignedSize + SizeClassGranularity - 1) / SizeClassGranularity]];
+#if QGFX_MEMORY_STATISTICS
+        m_Statistics.RecordAllocation(Allocator.GetBlockSize(), MemoryTagScope::GetCurrentTag());
+#endif
+        return Allocator.Allocate(Allocator.GetBlockSize(), Alignment);
+    }
+
+    void PoolAllocator::Free(void* Ptr)
+    {
+        if (Ptr == nullptr)
+            return;
+
+        if (FixedBlockMemoryAllocator* pOwner = FixedBlockMemoryAllocator::GetBlockOwner(Ptr, m_PageSize))
+        {
+#if QGFX_MEMORY_STATISTICS
+            m_Statistics.RecordFree(pOwner->GetBlockSize(), pOwner->GetBlockTag(Ptr));
+#endif
+            pOwner->Free(Ptr);
+        }
+        else
+        {
+            FreeLarge(Ptr);
+        }
+    }
+
+    size_t PoolAllocator::Trim()
+    {
+        size_t NumReleasedBytes = 0;
+        for (auto& Allocator : m_SizeClassAllocators)
+            NumReleasedBytes += Allocator->Trim();
+        return NumReleasedBytes;
+    }
+
+    void* PoolAllocator::AllocateLarge(size_t Size, size_t Alignment)
+    {
+        // The header must stay within the first page so that Free() can find it
+        const size_t Offset = AlignUp(sizeof(LargeAllocationHeader), std::max(Alignment, alignof(std::max_align_t)));
+        QGFX_VERIFY(Offset < m_PageSize, "Alignment (", Alignment, ") must be less than the page size (", m_PageSize, ")");
+
+        uint8_t* pStart = reinterpret_cast<uint8_t*>(m_RawMemoryAllocator.Allocate(Offset + Size, m_PageSize));
+        new (pStart) LargeAllocationHeader{ nullptr, Size, MemoryTagScope::GetCurrentTag() };
+#if QGFX_MEMORY_STATISTICS
+        m_Statistics.RecordAllocation(Size, reinterpret_cast<LargeAllocationHeader*>(pStart)->Tag);
+#endif
+        return pStart + Offset;
+    }
+
+    void PoolAllocator::FreeLarge(void* Ptr)
+    {
+        QGFX_VERIFY(reinterpret_cast<uint8_t*>(Ptr) - reinterpret_cast<uint8_t*>(AlignDown(Ptr, m_PageSize)) >= static_cast<ptrdiff_t>(sizeof(LargeAllocationHeader)),
+                    "Address was not allocated by this allocator");
+
+        auto* pHeader = reinterpret_cast<LargeAllocationHeader*>(AlignDown(Ptr, m_PageSize));
+#if QGFX_MEMORY_STATISTICS
+        m_Statistics.RecordFree(pHeader->Size, pHeader->Tag);
+#endif
+        m_RawMemoryAllocator.Free(pHeader);
+    }
+}
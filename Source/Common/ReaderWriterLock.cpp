@@ -0,0 +1,112 @@
+#include "Qgfx/Common/ReaderWriterLock.hpp"
+#include "Qgfx/Common/SpinLock.hpp"
+#include "Qgfx/Common/ThreadIndex.hpp"
+
+#include <thread>
+
+namespace Qgfx
+{
+    static_assert((ReaderWriterLock::NumStripes & (ReaderWriterLock::NumStripes - 1)) == 0, "NumStripes must be a power of two");
+
+    // Spins until Condition() holds, pausing between looks and yielding now and then
+    template <typename ConditionType>
+    static void SpinUntil(ConditionType&& Condition) noexcept
+    {
+        int SpinCount = 0;
+        while (!Condition())
+        {
+            SpinLock::Pause();
+            if (++SpinCount == SpinLock::DefaultSpinCountToYield)
+            {
+                SpinCount = 0;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    ReaderWriterLock::ReaderWriterLock() noexcept :
+        m_WriterFlag{ 0 }
+    {
+        for (Stripe& ReaderStripe : m_Stripes)
+            Atomics::Store(ReaderStripe.NumReaders, Long{ 0 }, MemoryOrder::eRelaxed);
+    }
+
+    AtomicLong& ReaderWriterLock::GetCurrentThreadStripe() noexcept
+    {
+        return m_Stripes[GetCurrentThreadIndex() & (NumStripes - 1)].NumReaders;
+    }
+
+    bool ReaderWriterLock::TryLockShared() noexcept
+    {
+        AtomicLong& NumReaders = GetCurrentThreadStripe();
+
+        // The increment and the load of the writer flag must not be reordered, and neither must the writer's
+        // store of the flag and its loads of the stripes, so both sides are sequentially consistent. Then
+        // either the reader sees the writer and backs out, or the writer sees the reader and waits.
+        Atomics::Increment(NumReaders);
+        if (Atomics::Load(m_WriterFlag) == 0)
+            return true;
+
+        Atomics::Decrement(NumReaders, MemoryOrder::eRelease);
+        return false;
+    }
+
+    void ReaderWriterLock::LockShared() noexcept
+    {
+        while (!TryLockShared())
+        {
+            // Stay out of the stripe while the writer is there, so that it does not wait for us
+            SpinUntil([this]() { return Atomics::Load(m_WriterFlag, MemoryOrder::eRelaxed) == 0; });
+        }
+    }
+
+    void ReaderWriterLock::UnlockShared() noexcept
+    {
+        // Release, so that the reads made under the lock complete before a writer may change the data
+        const Long NumReaders = Atomics::Decrement(GetCurrentThreadStripe(), MemoryOrder::eRelease);
+        QGFX_VERIFY(NumReaders >= 0, "Inconsistent call to UnlockShared()");
+        (void)NumReaders;
+    }
+
+    void ReaderWriterLock::WaitForReaders() noexcept
+    {
+        for (Stripe& ReaderStripe : m_Stripes)
+            SpinUntil([&ReaderStripe]() { return Atomics::Load(ReaderStripe.NumReaders) == 0; });
+
+        // Pairs with the release in UnlockShared()
+        Atomics::ThreadFence(MemoryOrder::eAcquire);
+    }
+
+    bool ReaderWriterLock::TryLock() noexcept
+    {
+        if (Atomics::Load(m_WriterFlag, MemoryOrder::eRelaxed) != 0 || Atomics::CompareExchange(m_WriterFlag, Long{ 1 }, Long{ 0 }) != 0)
+            return false;
+
+        for (Stripe& ReaderStripe : m_Stripes)
+        {
+            if (Atomics::Load(ReaderStripe.NumReaders) != 0)
+            {
+                Atomics::Store(m_WriterFlag, Long{ 0 }, MemoryOrder::eRelease);
+                return false;
+            }
+        }
+
+        Atomics::ThreadFence(MemoryOrder::eAcquire);
+        return true;
+    }
+
+    void ReaderWriterLock::Lock() noexcept
+    {
+        // Taking the flag first shuts out new readers, which is what gives writers priority
+        while (Atomics::CompareExchange(m_WriterFlag, Long{ 1 }, Long{ 0 }) != 0)
+            SpinUntil([this]() { return Atomics::Load(m_WriterFlag, MemoryOrder::eRelaxed) == 0; });
+
+        WaitForReaders();
+    }
+
+    void ReaderWriterLock::Unlock() noexcept
+    {
+        QGFX_VERIFY(Atomics::Load(m_WriterFlag, MemoryOrder::eRelaxed) != 0, "Inconsistent call to Unlock()");
+        Atomics::Store(m_WriterFlag, Long{ 0 }, MemoryOrder::eRelease);
+    }
+}
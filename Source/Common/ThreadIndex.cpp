@@ -0,0 +1,13 @@
+#include "Qgfx/Common/ThreadIndex.hpp"
+
+#include "Qgfx/Platform/Atomics.hpp"
+
+namespace Qgfx
+{
+    uint32_t GetCurrentThreadIndex()
+    {
+        static AtomicLong s_NextThreadIndex{ 0 };
+        thread_local const uint32_t ThreadIndex = static_cast<uint32_t>(Atomics::Increment(s_NextThreadIndex, MemoryOrder::eRelaxed));
+        return ThreadIndex;
+    }
+}
@@ -46,6 +46,11 @@ namespace Qgfx
 		*ppQueue = m_pQueue;
 	}
 
+	RefPtr<IQueue> ICommandBuffer::GetQueue()
+	{
+		return RefPtr<IQueue>{ m_pQueue };
+	}
+
 	IQueue::IQueue(IDevice* pDevice)
 		: m_pDevice(pDevice)
 	{
@@ -63,6 +68,11 @@ namespace Qgfx
 		*ppDevice = m_pDevice;
 	}
 
+	RefPtr<IDevice> IQueue::GetDevice()
+	{
+		return RefPtr<IDevice>{ m_pDevice };
+	}
+
 	ISwapChain::ISwapChain(IRenderer* pRenderer, IQueue* pQueue, const SwapChainDesc& Descriptor)
 		: m_pRenderer(pRenderer), m_pQueue(pQueue)
 	{
@@ -142,12 +152,22 @@ namespace Qgfx
 		*ppQueue = m_pQueue;
 	}
 
+	RefPtr<IQueue> ISwapChain::GetQueue()
+	{
+		return RefPtr<IQueue>{ m_pQueue };
+	}
+
 	void ISwapChain::GetRenderer(IRenderer** ppRenderer)
 	{
 		m_pRenderer->AddRef();
 		*ppRenderer = m_pRenderer;
 	}
 
+	RefPtr<IRenderer> ISwapChain::GetRenderer()
+	{
+		return RefPtr<IRenderer>{ m_pRenderer };
+	}
+
 	IDevice::IDevice(IRenderer* pRenderer, IAdapter* pAdapter)
 		: m_pRenderer(pRenderer), m_pAdapter(pAdapter)
 	{
@@ -167,12 +187,22 @@ namespace Qgfx
 		*ppRenderer = m_pRenderer;
 	}
 
+	RefPtr<IRenderer> IDevice::GetRenderer()
+	{
+		return RefPtr<IRenderer>{ m_pRenderer };
+	}
+
 	void IDevice::GetAdapter(IAdapter** ppAdapter)
 	{
 		m_pAdapter->AddRef();
 		*ppAdapter = m_pAdapter;
 	}
 
+	RefPtr<IAdapter> IDevice::GetAdapter()
+	{
+		return RefPtr<IAdapter>{ m_pAdapter };
+	}
+
 	IMemoryAllocator& IDevice::GetRawMemAllocator()
 	{
 		return m_pRenderer->GetRawMemAllocator();
@@ -195,6 +225,11 @@ namespace Qgfx
 		*ppRenderer = m_pRenderer;
 	}
 
+	RefPtr<IRenderer> IAdapter::GetRenderer()
+	{
+		return RefPtr<IRenderer>{ m_pRenderer };
+	}
+
 	IRenderer::IRenderer()
 		: m_RawMemAllocator(DefaultRawMemoryAllocator::GetAllocator())
 	{
@@ -1,6 +1,7 @@
 #include "Qgfx/Graphics/Vulkan/CommandQueueVk.hpp"
 #include "Qgfx/Graphics/Vulkan/CommandBufferVk.hpp"
 #include "Qgfx/Graphics/Vulkan/SwapChainVk.hpp"
+#include "Qgfx/Common/LockProfiler.hpp"
 #include "Qgfx/Common/ValidatedCast.hpp"
 
 namespace Qgfx
@@ -98,8 +99,11 @@ namespace Qgfx
 
 	CommandQueueVk::CommandQueueVk(IEngineFactory* pEngineFactory, RenderDeviceVk* pRenderDevice, HardwareQueueVk* pHardwareQueue, bool bDefaultQueue)
 		: ICommandQueue(pEngineFactory, CommandQueueType::eGeneral), m_pRenderDevice(pRenderDevice), m_pHardwareQueue(pHardwareQueue), m_bDefaultQueue(bDefaultQueue),
+		m_SubmissionFences(&m_ReleaseListsMemory), m_CommandBuffersToFree(&m_ReleaseListsMemory),
+		m_SemaphoresToDelete(&m_ReleaseListsMemory), m_TexturesToDelete(&m_ReleaseListsMemory),
 		m_FencePool(pRenderDevice), m_AcquiredSemaphorePool(pRenderDevice),
-		m_CommandBufferObjectAllocator(*nullptr, sizeof(CommandBufferVk), 128)
+		m_CommandBufferObjectAllocator(*nullptr, sizeof(CommandBufferVk), 128),
+		m_SubmitScratchAllocator(DefaultRawMemoryAllocator::GetAllocator())
 	{
 		m_Type = pHardwareQueue->GetQueueType();
 
@@ -134,7 +138,7 @@ namespace Qgfx
 		vk::Device VkDevice = m_pRenderDevice->GetVkDevice();
 		const vk::DispatchLoaderDynamic& VkDispatch = m_pRenderDevice->GetVkDispatch();
 
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		CheckPendingSubmissions(false);
 
@@ -147,7 +151,9 @@ namespace Qgfx
 
 		vk::Fence CompletionFence = m_FencePool.GetFence();
 
-		std::vector<vk::CommandBuffer> CommandBuffers;
+		m_SubmitScratchAllocator.SetCurrentIndex(m_NextSubmissionIndex);
+
+		vk::CommandBuffer* pVkCommandBuffers = m_SubmitScratchAllocator.AllocateArray<vk::CommandBuffer>(NumCommandBuffers);
 
 		for (uint32_t Index = 0; Index < NumCommandBuffers; Index++)
 		{
@@ -160,22 +166,24 @@ namespace Qgfx
 
 			m_CommandBuffersToFree.push_back(CmdBufferToFree);
 
-			CommandBuffers.push_back(pCommandBuffer->m_VkCmdBuffer);
+			pVkCommandBuffers[Index] = pCommandBuffer->m_VkCmdBuffer;
 			pCommandBuffer->m_VkCmdPool = nullptr;
 			pCommandBuffer->m_VkCmdBuffer = nullptr;
 		}
 
-		std::vector<vk::PipelineStageFlags> WaitStageMasks{ m_WaitSemaphores.size(), vk::PipelineStageFlagBits::eAllCommands };
+		vk::PipelineStageFlags* pWaitStageMasks = m_SubmitScratchAllocator.AllocateArray<vk::PipelineStageFlags>(m_WaitSemaphores.size());
+		for (size_t Index = 0; Index < m_WaitSemaphores.size(); Index++)
+			pWaitStageMasks[Index] = vk::PipelineStageFlagBits::eAllCommands;
 
 		vk::SubmitInfo SubmitInfo{};
 		SubmitInfo.pNext = nullptr;
-		SubmitInfo.commandBufferCount = static_cast<uint32_t>(CommandBuffers.size());
-		SubmitInfo.pCommandBuffers = nullptr;
+		SubmitInfo.commandBufferCount = NumCommandBuffers;
+		SubmitInfo.pCommandBuffers = pVkCommandBuffers;
 		SubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(m_SignalSemaphores.size());
 		SubmitInfo.pSignalSemaphores = m_SignalSemaphores.data();
 		SubmitInfo.waitSemaphoreCount = static_cast<uint32_t>(m_WaitSemaphores.size());
 		SubmitInfo.pWaitSemaphores = m_WaitSemaphores.data();
-		SubmitInfo.pWaitDstStageMask = WaitStageMasks.data();
+		SubmitInfo.pWaitDstStageMask = pWaitStageMasks;
 
 		m_pHardwareQueue->Submit(SubmitInfo, CompletionFence);
 
@@ -193,14 +201,14 @@ namespace Qgfx
 
 	void CommandQueueVk::Present(const vk::PresentInfoKHR& PresentInfo)
 	{
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		m_pHardwareQueue->Present(PresentInfo);
 	}
 
 	void CommandQueueVk::ReleasePoolAndBuffer(vk::CommandPool VkCmdPool, vk::CommandBuffer VkCmdBuffer)
 	{
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		CommandPoolAndBuffer PoolAndBuffer{};
 		PoolAndBuffer.Pool = VkCmdPool;
@@ -211,7 +219,7 @@ namespace Qgfx
 
 	void CommandQueueVk::DeleteSemaphoreWhenUnused(vk::Semaphore Semaphore)
 	{
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		SemaphoreToDelete SemToDelete{};
 		SemToDelete.Index = m_NextSubmissionIndex;
@@ -222,7 +230,7 @@ namespace Qgfx
 
 	void CommandQueueVk::DeleteTextureWhenUnused(vk::Image Image, VmaAllocation Allocation)
 	{
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		TextureToDelete TexToDelete{};
 		TexToDelete.Index = m_NextSubmissionIndex;
@@ -234,14 +242,14 @@ namespace Qgfx
 
 	void CommandQueueVk::AddSignalSemaphore(vk::Semaphore Signal)
 	{
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		m_SignalSemaphores.push_back(Signal);
 	}
 
 	void CommandQueueVk::AddWaitSemaphore(vk::Semaphore Wait)
 	{
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		m_WaitSemaphores.push_back(Wait);
 	}
@@ -278,6 +286,8 @@ namespace Qgfx
 			}
 		}
 
+		m_SubmitScratchAllocator.ReleaseCompleted(m_CompletedSubmissionIndex);
+
 		while (!m_CommandBuffersToFree.empty())
 		{
 			CommandBufferToFree& CmdToFree = m_CommandBuffersToFree.front();
@@ -330,32 +340,37 @@ namespace Qgfx
 		vk::Device VkDevice = m_pRenderDevice->GetVkDevice();
 		const vk::DispatchLoaderDynamic& VkDispatch = m_pRenderDevice->GetVkDispatch();
 
-		std::lock_guard Lock{ m_Mutex };
-
-		if (m_AvailablePoolsAndBuffers.empty())
+		// Only taking a pool and buffer needs the queue lock. Object allocation is served by the
+		// allocator's thread cache and does not need it.
+		CommandPoolAndBuffer PoolAndBuffer{};
 		{
-			CommandPoolAndBuffer PoolAndBuffer{};
+			QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
-			vk::CommandPoolCreateInfo PoolCI{};
-			PoolCI.pNext = nullptr;
-			PoolCI.flags = {};
-			PoolCI.queueFamilyIndex = m_pHardwareQueue->GetVkQueueFamilyIndex();
+			if (m_AvailablePoolsAndBuffers.empty())
+			{
+				CommandPoolAndBuffer NewPoolAndBuffer{};
 
-			PoolAndBuffer.Pool = VkDevice.createCommandPool(PoolCI, nullptr, VkDispatch);
+				vk::CommandPoolCreateInfo PoolCI{};
+				PoolCI.pNext = nullptr;
+				PoolCI.flags = {};
+				PoolCI.queueFamilyIndex = m_pHardwareQueue->GetVkQueueFamilyIndex();
 
-			vk::CommandBufferAllocateInfo AllocInfo{};
-			AllocInfo.pNext = nullptr;
-			AllocInfo.commandPool = PoolAndBuffer.Pool;
-			AllocInfo.level = vk::CommandBufferLevel::ePrimary;
-			AllocInfo.commandBufferCount = 1;
+				NewPoolAndBuffer.Pool = VkDevice.createCommandPool(PoolCI, nullptr, VkDispatch);
 
-			vk::throwResultException(VkDevice.allocateCommandBuffers(&AllocInfo, &PoolAndBuffer.Buffer, VkDispatch), "Failed to allocate command buffer");
+				vk::CommandBufferAllocateInfo AllocInfo{};
+				AllocInfo.pNext = nullptr;
+				AllocInfo.commandPool = NewPoolAndBuffer.Pool;
+				AllocInfo.level = vk::CommandBufferLevel::ePrimary;
+				AllocInfo.commandBufferCount = 1;
 
-			m_AvailablePoolsAndBuffers.push_back(PoolAndBuffer);
-		}
+				vk::throwResultException(VkDevice.allocateCommandBuffers(&AllocInfo, &NewPoolAndBuffer.Buffer, VkDispatch), "Failed to allocate command buffer");
 
-		CommandPoolAndBuffer PoolAndBuffer = m_AvailablePoolsAndBuffers.back();
-		m_AvailablePoolsAndBuffers.pop_back();
+				m_AvailablePoolsAndBuffers.push_back(NewPoolAndBuffer);
+			}
+
+			PoolAndBuffer = m_AvailablePoolsAndBuffers.back();
+			m_AvailablePoolsAndBuffers.pop_back();
+		}
 
 		vk::CommandBufferBeginInfo BeginInfo{};
 		BeginInfo.pNext = nullptr;
@@ -374,14 +389,12 @@ namespace Qgfx
 	{
 		ValidatedCast<CommandBufferVk>(pCommandBuffer)->~CommandBufferVk();
 
-		std::lock_guard Lock{ m_Mutex };
-
 		m_CommandBufferObjectAllocator.Free(pCommandBuffer);
 	}
 
 	void CommandQueueVk::WaitIdle()
 	{
-		std::lock_guard Lock{ m_Mutex };
+		QGFX_LOCK_GUARD(Lock, m_Mutex, "CommandQueueVk::m_Mutex");
 
 		m_pHardwareQueue->WaitIdle();
 	}
@@ -1,5 +1,7 @@
 #include "Qgfx/Graphics/Vulkan/VulkanRenderer.hpp"
+#include "Qgfx/Common/LockProfiler.hpp"
 #include "Qgfx/Common/MemoryAllocator.hpp"
+#include "Qgfx/Common/MemoryResource.hpp"
 
 namespace Qgfx
 {
@@ -41,8 +43,12 @@ namespace Qgfx
 
 		m_VkDispatch.init(NativeDescriptor.pfnLoaderHandle);
 
-		std::vector<const char*> EnabledExtensions{};
-		std::vector<const char*> EnabledLayers{};
+		// Instance creation scratch lives on the stack
+		uint8_t ScratchBuffer[512];
+		MonotonicMemoryResource ScratchMemory{ ScratchBuffer, sizeof(ScratchBuffer) };
+
+		std::pmr::vector<const char*> EnabledExtensions{ &ScratchMemory };
+		std::pmr::vector<const char*> EnabledLayers{ &ScratchMemory };
 
 		EnabledExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 
@@ -143,11 +149,13 @@ namespace Qgfx
 
 	void VulkanRenderer::CreateDevice(IAdapter* pAdapter, const DeviceDesc& Descriptor, IDevice** ppDevice)
 	{
+		QGFX_MEMORY_TAG(MemoryTag::eDevice);
 		*ppDevice =  new VulkanDevice(this, ValidatedCast<VulkanAdapter>(pAdapter), Descriptor);
 	}
 
 	void VulkanRenderer::CreateSwapChain(IQueue* pQueue, const SwapChainDesc& Descriptor, ISwapChain** ppSwapChain)
 	{
+		QGFX_MEMORY_TAG(MemoryTag::eSwapChain);
 		*ppSwapChain = new VulkanSwapChain(this, ValidatedCast<VulkanQueue>(pQueue), Descriptor);
 	}
 
@@ -227,7 +235,11 @@ namespace Qgfx
 
 		bool bMemoryBudgetExtEnabled = false;
 
-		std::vector<const char*> EnabledExtensions{};
+		// Device creation scratch lives on the stack
+		uint8_t ScratchBuffer[1024];
+		MonotonicMemoryResource ScratchMemory{ ScratchBuffer, sizeof(ScratchBuffer) };
+
+		std::pmr::vector<const char*> EnabledExtensions{ &ScratchMemory };
 		EnabledExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
 		for (auto& Extension : SupportedExtensions)
@@ -248,8 +260,8 @@ namespace Qgfx
 		std::vector<vk::QueueFamilyProperties> QueueFamilyProps = m_VkPhDevice.getQueueFamilyProperties(m_VkDispatch);
 
 		uint32_t QueueCreateInfoCount = 0;
-		std::vector<vk::DeviceQueueCreateInfo> QueueCreateInfos(QueueFamilyProps.size());
-		std::vector<std::vector<float>> QueueCreateInfoPriorities(QueueCreateInfos.size());
+		std::pmr::vector<vk::DeviceQueueCreateInfo> QueueCreateInfos(QueueFamilyProps.size(), &ScratchMemory);
+		std::pmr::vector<std::pmr::vector<float>> QueueCreateInfoPriorities(QueueCreateInfos.size(), &ScratchMemory);
 
 		
 		for (uint32_t Index = 0; Index < QueueFamilyProps.size(); Index++)
@@ -421,6 +433,7 @@ namespace Qgfx
 
 	IQueue* VulkanDevice::CreateQueue(const QueueDesc& Descriptor)
 	{
+		QGFX_MEMORY_TAG(MemoryTag::eQueue);
 		return new VulkanQueue(this, Descriptor);
 	}
 
@@ -460,13 +473,13 @@ namespace Qgfx
 
 	void VulkanDevice::VkQueueSubmit(vk::Queue VkQueue, const vk::ArrayProxy<const vk::SubmitInfo>& Submits, vk::Fence VkFence)
 	{
-		std::lock_guard Lock{ m_SubmitMutex };
+		QGFX_LOCK_GUARD(Lock, m_SubmitLockFlag, "VulkanDevice::m_SubmitLockFlag");
 		VkQueue.submit(Submits, VkFence, m_VkDispatch);
 	}
 
 	vk::Result VulkanDevice::VkQueuePresent(vk::Queue VkQueue, const vk::PresentInfoKHR& Present)
 	{
-		std::lock_guard Lock{ m_SubmitMutex };
+		QGFX_LOCK_GUARD(Lock, m_SubmitLockFlag, "VulkanDevice::m_SubmitLockFlag");
 		return VkQueue.presentKHR(Present, m_VkDispatch);
 	}
 
@@ -500,8 +513,10 @@ namespace Qgfx
 
 	void VulkanQueue::CreateCommandBuffer(ICommandBuffer** ppCommandBuffer)
 	{
-		std::lock_guard Lock{ m_AllocMutex };
+		QGFX_MEMORY_TAG(MemoryTag::eQueue);
 
+		// The object allocator is thread safe and serves most requests from a per-thread cache,
+		// so no queue lock is taken here.
 		VulkanCommandBuffer* pCommandBuffer = reinterpret_cast<VulkanCommandBuffer*>(m_CommandBufferObjAllocator.Allocate(sizeof(VulkanCommandBuffer)));
 		new(pCommandBuffer) VulkanCommandBuffer(this);
 		*ppCommandBuffer = pCommandBuffer;
@@ -514,8 +529,6 @@ namespace Qgfx
 
 	void VulkanQueue::DestroyVulkanCommandBuffer(VulkanCommandBuffer* pCommandBuffer)
 	{
-		std::lock_guard Lock{ m_AllocMutex };
-
 		pCommandBuffer->~VulkanCommandBuffer();
 		m_CommandBufferObjAllocator.Free(pCommandBuffer);
 	}
@@ -0,0 +1,292 @@
+#include "Qgfx/Platform/Linux/LinuxVirtualMemoryAllocator.hpp"
+#include "Qgfx/Common/Align.hpp"
+#include "Qgfx/Common/Error.hpp"
+
+#include <algorithm>
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Qgfx
+{
+    // Avoid a dependency on libnuma, only the mbind() system call is needed
+    static constexpr int           MemoryPolicyBind = 2; // MPOL_BIND
+    static constexpr unsigned long MaxNumaNodes = 1024;
+
+    static uint32_t GetSizeLog2(size_t Size)
+    {
+        uint32_t SizeLog2 = 0;
+        while ((size_t{ 1 } << SizeLog2) < Size)
+            ++SizeLog2;
+        return SizeLog2;
+    }
+
+    LinuxVirtualMemoryAllocator::LinuxVirtualMemoryAllocator(const VirtualMemoryAllocatorDesc& Desc) :
+        m_ReserveSize{ AlignUp(std::max(Desc.ReserveSize, CommitGranularity), CommitGranularity) },
+        m_NumaNode{ Desc.NumaNode }
+    {
+        static_assert((size_t{ 1 } << MinBlockSizeLog2) == MinBlockSize, "MinBlockSizeLog2 does not match MinBlockSize");
+        static_assert((size_t{ 1 } << CommitGranularityLog2) == CommitGranularity, "CommitGranularityLog2 does not match CommitGranularity");
+
+        if (m_ReserveSize / MinBlockSize >= InvalidGranule)
+            QGFX_LOG_ERROR_AND_THROW("Reserve size ", m_ReserveSize, " is too large, granules are indexed with 32 bits");
+
+        // Reserve address space only. Pages are made accessible by Commit().
+        void* pBase = MAP_FAILED;
+        if (Desc.bUseHugeTLB)
+        {
+            pBase = mmap(nullptr, m_ReserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_HUGETLB, -1, 0);
+            m_bHugeTLB = pBase != MAP_FAILED;
+            if (!m_bHugeTLB)
+                QGFX_LOG_WARNING_MESSAGE("MAP_HUGETLB reservation of ", m_ReserveSize, " bytes failed, falling back to regular pages");
+        }
+
+        if (pBase == MAP_FAILED)
+        {
+            // Over-reserve so that the range can be aligned to the commit granularity, which
+            // lets the kernel back it with transparent huge pages.
+            const size_t MappingSize = m_ReserveSize + CommitGranularity;
+            void*        pMapping = mmap(nullptr, MappingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (pMapping == MAP_FAILED)
+                QGFX_LOG_ERROR_AND_THROW("Failed to reserve ", m_ReserveSize, " bytes of address space");
+
+            uint8_t* pMappingStart = reinterpret_cast<uint8_t*>(pMapping);
+            uint8_t* pAlignedStart = AlignUp(pMappingStart, CommitGranularity);
+            if (pAlignedStart != pMappingStart)
+                munmap(pMappingStart, pAlignedStart - pMappingStart);
+            if (pAlignedStart + m_ReserveSize != pMappingStart + MappingSize)
+                munmap(pAlignedStart + m_ReserveSize, (pMappingStart + MappingSize) - (pAlignedStart + m_ReserveSize));
+
+            pBase = pAlignedStart;
+
+            if (Desc.bUseTransparentHugePages)
+                madvise(pBase, m_ReserveSize, MADV_HUGEPAGE);
+        }
+
+        m_pBase = reinterpret_cast<uint8_t*>(pBase);
+        m_pNext = m_pBase;
+        m_pCommitEnd = m_pBase;
+
+        // Free block links and one size byte per granule. The tables are only touched where blocks are
+        // allocated, so the kernel materializes just the parts that are in use.
+        void* pTables = mmap(nullptr, GetTablesSize(m_ReserveSize), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (pTables == MAP_FAILED)
+        {
+            munmap(m_pBase, m_ReserveSize);
+            QGFX_LOG_ERROR_AND_THROW("Failed to allocate the block tables");
+        }
+        m_pFreeBlockLinks = reinterpret_cast<FreeBlockLinks*>(pTables);
+        m_pBlockSizeLog2 = reinterpret_cast<uint8_t*>(m_pFreeBlockLinks + m_ReserveSize / MinBlockSize);
+
+        std::fill(std::begin(m_FreeBlocks), std::end(m_FreeBlocks), InvalidGranule);
+    }
+
+    LinuxVirtualMemoryAllocator::~LinuxVirtualMemoryAllocator()
+    {
+        munmap(m_pFreeBlockLinks, GetTablesSize(m_ReserveSize));
+        munmap(m_pBase, m_ReserveSize);
+    }
+
+    void* LinuxVirtualMemoryAllocator::Allocate(size_t Size)
+    {
+        return Allocate(Size, alignof(std::max_align_t));
+    }
+
+    void* LinuxVirtualMemoryAllocator::Allocate(size_t Size, size_t Alignment)
+    {
+        QGFX_VERIFY_EXPR(Size > 0);
+        QGFX_VERIFY(IsPowerOfTwo(Alignment), "Alignment (", Alignment, ") must be power of 2");
+
+        // Blocks are aligned to their size, so a block that is at least Alignment bytes large is
+        // sufficiently aligned.
+        const uint32_t SizeLog2 = GetSizeLog2(std::max({ Size, Alignment, MinBlockSize }));
+        if ((size_t{ 1 } << SizeLog2) <= m_ReserveSize)
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+            if (void* Ptr = AllocateFromRange(SizeLog2))
+            {
+#if QGFX_MEMORY_STATISTICS
+                m_Statistics.RecordAllocation(size_t{ 1 } << SizeLog2, MemoryTag::eGeneral);
+#endif
+                return Ptr;
+            }
+        }
+
+        return DefaultRawMemoryAllocator::GetAllocator().Allocate(Size, Alignment);
+    }
+
+    void LinuxVirtualMemoryAllocator::Free(void* Ptr)
+    {
+        if (Ptr == nullptr)
+            return;
+
+        if (!Contains(Ptr))
+        {
+            DefaultRawMemoryAllocator::GetAllocator().Free(Ptr);
+            return;
+        }
+
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+        uint8_t* pBlock = reinterpret_cast<uint8_t*>(Ptr);
+        uint32_t SizeLog2 = m_pBlockSizeLog2[GetGranule(pBlock)];
+        QGFX_VERIFY((SizeLog2 & FreeBlockFlag) == 0, "The block at ", Ptr, " has already been freed");
+
+#if QGFX_MEMORY_STATISTICS
+        m_Statistics.RecordFree(size_t{ 1 } << SizeLog2, MemoryTag::eGeneral);
+#endif
+
+        // Merge the block with its buddy for as long as the buddy is free as a whole. Blocks are aligned to
+        // their size by address, so the buddy is found by address too, and only blocks below m_pNext exist.
+        while (SizeLog2 + 1 < MaxSizeClasses)
+        {
+            uint8_t* const pBuddy = reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(pBlock) ^ (uintptr_t{ 1 } << SizeLog2));
+            if (pBuddy < m_pBase || pBuddy >= m_pNext || m_pBlockSizeLog2[GetGranule(pBuddy)] != (SizeLog2 | FreeBlockFlag))
+                break;
+
+            RemoveFreeBlock(GetGranule(pBuddy), SizeLog2);
+
+            // Only the lower half starts the merged block
+            uint8_t* const pUpper = std::max(pBlock, pBuddy);
+            m_pBlockSizeLog2[GetGranule(pUpper)] = 0;
+            pBlock = std::min(pBlock, pBuddy);
+            ++SizeLog2;
+        }
+
+        // Blocks this large cover whole huge pages, which can go back to the system. The range stays
+        // accessible, and the pages are faulted in again, zeroed, when the block is reused.
+        if (SizeLog2 >= CommitGranularityLog2)
+            madvise(pBlock, size_t{ 1 } << SizeLog2, MADV_DONTNEED);
+
+        PushFreeBlock(pBlock, SizeLog2);
+    }
+
+    size_t LinuxVirtualMemoryAllocator::GetCommittedSize()
+    {
+        std::lock_guard<std::mutex> LockGuard(m_Mutex);
+        return m_pCommitEnd - m_pBase;
+    }
+
+    LinuxVirtualMemoryAllocator& LinuxVirtualMemoryAllocator::GetAllocator()
+    {
+        static LinuxVirtualMemoryAllocator Allocator;
+        return Allocator;
+    }
+
+    void* LinuxVirtualMemoryAllocator::AllocateFromRange(uint32_t SizeLog2)
+    {
+        // Take the smallest free block that is large enough, and return the upper halves to the free lists
+        // until it has the requested size
+        if (const uint64_t LargeEnoughMask = m_FreeBlockMask >> SizeLog2)
+        {
+            uint32_t       FreeLog2 = SizeLog2 + static_cast<uint32_t>(__builtin_ctzll(LargeEnoughMask));
+            const uint32_t Granule = m_FreeBlocks[FreeLog2];
+            RemoveFreeBlock(Granule, FreeLog2);
+
+            uint8_t* const pBlock = m_pBase + size_t{ Granule } * MinBlockSize;
+            while (FreeLog2 > SizeLog2)
+            {
+                --FreeLog2;
+                PushFreeBlock(pBlock + (size_t{ 1 } << FreeLog2), FreeLog2);
+            }
+
+            m_pBlockSizeLog2[Granule] = static_cast<uint8_t>(SizeLog2);
+            return pBlock;
+        }
+
+        const size_t BlockSize = size_t{ 1 } << SizeLog2;
+
+        // The address is aligned, not the offset, as the range start is only aligned to CommitGranularity
+        // and blocks may be larger than that
+        const size_t Offset = AlignUp(reinterpret_cast<uintptr_t>(m_pNext), BlockSize) - reinterpret_cast<uintptr_t>(m_pBase);
+        if (Offset > m_ReserveSize || BlockSize > m_ReserveSize - Offset)
+            return nullptr;
+
+        uint8_t* pBlock = m_pBase + Offset;
+        if (pBlock + BlockSize > m_pCommitEnd && !Commit(pBlock + BlockSize))
+            return nullptr;
+
+        // Keep the alignment gap for smaller requests by splitting it into blocks aligned to their size
+        while (m_pNext < pBlock)
+        {
+            const uintptr_t GapAddress = reinterpret_cast<uintptr_t>(m_pNext);
+            uint32_t        GapLog2 = MinBlockSizeLog2;
+            while (GapAddress % (uintptr_t{ 2 } << GapLog2) == 0 && m_pNext + (size_t{ 2 } << GapLog2) <= pBlock)
+                ++GapLog2;
+
+            PushFreeBlock(m_pNext, GapLog2);
+            m_pNext += size_t{ 1 } << GapLog2;
+        }
+
+        m_pNext = pBlock + BlockSize;
+        m_pBlockSizeLog2[GetGranule(pBlock)] = static_cast<uint8_t>(SizeLog2);
+        return pBlock;
+    }
+
+    bool LinuxVirtualMemoryAllocator::Commit(uint8_t* pCommitEnd)
+    {
+        uint8_t* pNewCommitEnd = m_pBase + AlignUp(static_cast<size_t>(pCommitEnd - m_pBase), CommitGranularity);
+        QGFX_VERIFY_EXPR(pNewCommitEnd <= m_pBase + m_ReserveSize);
+
+        const size_t CommitSize = pNewCommitEnd - m_pCommitEnd;
+        if (mprotect(m_pCommitEnd, CommitSize, PROT_READ | PROT_WRITE) != 0)
+        {
+            QGFX_LOG_ERROR_MESSAGE("Failed to commit ", CommitSize, " bytes of reserved memory");
+            return false;
+        }
+
+        // The policy takes effect when the pages are first touched, so it must be set before any block is used
+        if (m_NumaNode >= 0)
+        {
+            unsigned long NodeMask[MaxNumaNodes / (8 * sizeof(unsigned long))] = {};
+            if (static_cast<unsigned long>(m_NumaNode) < MaxNumaNodes)
+            {
+                NodeMask[m_NumaNode / (8 * sizeof(unsigned long))] = 1ul << (m_NumaNode % (8 * sizeof(unsigned long)));
+                if (syscall(SYS_mbind, m_pCommitEnd, CommitSize, MemoryPolicyBind, NodeMask, MaxNumaNodes, 0) != 0)
+                    QGFX_LOG_WARNING_MESSAGE_ONCE("Failed to bind memory to NUMA node ", m_NumaNode);
+            }
+            else
+            {
+                QGFX_LOG_WARNING_MESSAGE_ONCE("NUMA node ", m_NumaNode, " is out of range");
+            }
+        }
+
+        m_pCommitEnd = pNewCommitEnd;
+        return true;
+    }
+
+    void LinuxVirtualMemoryAllocator::PushFreeBlock(uint8_t* pBlock, uint32_t SizeLog2)
+    {
+        const uint32_t Granule = GetGranule(pBlock);
+        m_pBlockSizeLog2[Granule] = static_cast<uint8_t>(SizeLog2 | FreeBlockFlag);
+
+        const uint32_t Next = m_FreeBlocks[SizeLog2];
+        m_pFreeBlockLinks[Granule] = FreeBlockLinks{ InvalidGranule, Next };
+        if (Next != InvalidGranule)
+            m_pFreeBlockLinks[Next].Prev = Granule;
+
+        m_FreeBlocks[SizeLog2] = Granule;
+        m_FreeBlockMask |= uint64_t{ 1 } << SizeLog2;
+    }
+
+    void LinuxVirtualMemoryAllocator::RemoveFreeBlock(uint32_t Granule, uint32_t SizeLog2)
+    {
+        QGFX_VERIFY_EXPR(m_pBlockSizeLog2[Granule] == (SizeLog2 | FreeBlockFlag));
+        m_pBlockSizeLog2[Granule] = static_cast<uint8_t>(SizeLog2);
+
+        const FreeBlockLinks Links = m_pFreeBlockLinks[Granule];
+        if (Links.Prev != InvalidGranule)
+            m_pFreeBlockLinks[Links.Prev].Next = Links.Next;
+        else
+            m_FreeBlocks[SizeLog2] = Links.Next;
+
+        if (Links.Next != InvalidGranule)
+            m_pFreeBlockLinks[Links.Next].Prev = Links.Prev;
+
+        if (m_FreeBlocks[SizeLog2] == InvalidGranule)
+            m_FreeBlockMask &= ~(uint64_t{ 1 } << SizeLog2);
+    }
+}
@@ -1,5 +1,7 @@
 #include "Qgfx/Platform/Win32/Win32Atomics.hpp"
 
+#include <atomic>
+
 #include <Windows.h>
 
 namespace Qgfx
@@ -41,6 +43,11 @@ namespace Qgfx
         return InterlockedCompareExchange(&Destination, Exchange, Comparand);
     }
 
+    Numerics::Int64 WindowsAtomics::CompareExchange(AtomicInt64& Destination, Int64 Exchange, Int64 Comparand)
+    {
+        return InterlockedCompareExchange64(&Destination, Exchange, Comparand);
+    }
+
     Numerics::Long WindowsAtomics::Add(AtomicLong& Destination, Long Val)
     {
         return InterlockedAdd(&Destination, Val);
@@ -50,4 +57,153 @@ namespace Qgfx
     {
         return InterlockedAdd64(&Destination, Val);
     }
+
+    // Selects the interlocked function variant that matches Order
+#define QGFX_INTERLOCKED_WITH_ORDER(Order, Function, ...)    \
+    switch (Order)                                            \
+    {                                                         \
+    case MemoryOrder::eRelaxed:                               \
+        return Function##NoFence(__VA_ARGS__);                \
+    case MemoryOrder::eAcquire:                               \
+        return Function##Acquire(__VA_ARGS__);                \
+    case MemoryOrder::eRelease:                               \
+        return Function##Release(__VA_ARGS__);                \
+    default:                                                  \
+        return Function(__VA_ARGS__);                         \
+    }
+
+#define QGFX_INTERLOCKED64_WITH_ORDER(Order, Function, ...)  \
+    switch (Order)                                            \
+    {                                                         \
+    case MemoryOrder::eRelaxed:                               \
+        return Function##NoFence64(__VA_ARGS__);              \
+    case MemoryOrder::eAcquire:                               \
+        return Function##Acquire64(__VA_ARGS__);              \
+    case MemoryOrder::eRelease:                               \
+        return Function##Release64(__VA_ARGS__);              \
+    default:                                                  \
+        return Function##64(__VA_ARGS__);                     \
+    }
+
+    Numerics::Long WindowsAtomics::Increment(AtomicLong& Val, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED_WITH_ORDER(Order, InterlockedIncrement, &Val);
+    }
+
+    Numerics::Int64 WindowsAtomics::Increment(AtomicInt64& Val, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED64_WITH_ORDER(Order, InterlockedIncrement, &Val);
+    }
+
+    Numerics::Long WindowsAtomics::Decrement(AtomicLong& Val, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED_WITH_ORDER(Order, InterlockedDecrement, &Val);
+    }
+
+    Numerics::Int64 WindowsAtomics::Decrement(AtomicInt64& Val, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED64_WITH_ORDER(Order, InterlockedDecrement, &Val);
+    }
+
+    Numerics::Long WindowsAtomics::Load(AtomicLong& Val, MemoryOrder Order)
+    {
+        switch (Order)
+        {
+        case MemoryOrder::eRelaxed:
+            return ReadNoFence(&Val);
+        case MemoryOrder::eAcquire:
+            return ReadAcquire(&Val);
+        default:
+            return Val;
+        }
+    }
+
+    Numerics::Int64 WindowsAtomics::Load(AtomicInt64& Val, MemoryOrder Order)
+    {
+        switch (Order)
+        {
+        case MemoryOrder::eRelaxed:
+            return ReadNoFence64(&Val);
+        case MemoryOrder::eAcquire:
+            return ReadAcquire64(&Val);
+        default:
+            return Val;
+        }
+    }
+
+    void WindowsAtomics::Store(AtomicLong& Val, Long NewVal, MemoryOrder Order)
+    {
+        switch (Order)
+        {
+        case MemoryOrder::eRelaxed:
+            WriteNoFence(&Val, NewVal);
+            break;
+        case MemoryOrder::eRelease:
+            WriteRelease(&Val, NewVal);
+            break;
+        default:
+            InterlockedExchange(&Val, NewVal);
+            break;
+        }
+    }
+
+    void WindowsAtomics::Store(AtomicInt64& Val, Int64 NewVal, MemoryOrder Order)
+    {
+        switch (Order)
+        {
+        case MemoryOrder::eRelaxed:
+            WriteNoFence64(&Val, NewVal);
+            break;
+        case MemoryOrder::eRelease:
+            WriteRelease64(&Val, NewVal);
+            break;
+        default:
+            InterlockedExchange64(&Val, NewVal);
+            break;
+        }
+    }
+
+    Numerics::Long WindowsAtomics::CompareExchange(AtomicLong& Destination, Long Exchange, Long Comparand, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED_WITH_ORDER(Order, InterlockedCompareExchange, &Destination, Exchange, Comparand);
+    }
+
+    Numerics::Int64 WindowsAtomics::CompareExchange(AtomicInt64& Destination, Int64 Exchange, Int64 Comparand, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED64_WITH_ORDER(Order, InterlockedCompareExchange, &Destination, Exchange, Comparand);
+    }
+
+    Numerics::Long WindowsAtomics::Add(AtomicLong& Destination, Long Val, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED_WITH_ORDER(Order, InterlockedAdd, &Destination, Val);
+    }
+
+    Numerics::Int64 WindowsAtomics::Add(AtomicInt64& Destination, Int64 Val, MemoryOrder Order)
+    {
+        QGFX_INTERLOCKED64_WITH_ORDER(Order, InterlockedAdd, &Destination, Val);
+    }
+
+#undef QGFX_INTERLOCKED_WITH_ORDER
+#undef QGFX_INTERLOCKED64_WITH_ORDER
+
+    void WindowsAtomics::ThreadFence(MemoryOrder Order)
+    {
+        switch (Order)
+        {
+        case MemoryOrder::eRelaxed:
+            break;
+        case MemoryOrder::eAcquire:
+            std::atomic_thread_fence(std::memory_order_acquire);
+            break;
+        case MemoryOrder::eRelease:
+            std::atomic_thread_fence(std::memory_order_release);
+            break;
+        case MemoryOrder::eAcquireRelease:
+            std::atomic_thread_fence(std::memory_order_acq_rel);
+            break;
+        default:
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            break;
+        }
+    }
 }
\ No newline at end of file